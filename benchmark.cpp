@@ -0,0 +1,346 @@
+
+// Micro benchmarks for lazy_vector and the containers built on top of it
+// Build with optimizations, e.g.
+//   g++ -std=c++11 -O2 -pthread benchmark.cpp -o benchmark && ./benchmark
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "huge_page_allocator.h"
+#include "lazy_vector.h"
+#include "lazy_priority_queue.h"
+#include "lazy_ring_queue.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Returns the elapsed time between two time points in nanoseconds
+static double elapsed_ns(bench_clock::time_point start, bench_clock::time_point stop) {
+  return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+// Returns the p'th percentile (0 <= p <= 1) of the given samples - sorts them
+static double percentile(std::vector<double>& samples, double p) {
+  if (samples.empty()) return 0.0;
+  std::sort(samples.begin(), samples.end());
+  std::size_t idx = static_cast<std::size_t>(p * (samples.size() - 1));
+  return samples[idx];
+}
+
+static void report(const char* name, double total_ns, std::size_t ops,
+                   std::vector<double>& latencies) {
+  const double p50 = percentile(latencies, 0.5);
+  const double p999 = percentile(latencies, 0.999);
+  const double max = percentile(latencies, 1.0);
+  std::printf("%-40s %10.2f Mops/s   p50 %8.1f ns   p99.9 %10.1f ns   max %12.1f ns\n",
+              name, ops / (total_ns / 1e3), p50, p999, max);
+}
+
+// Counts a hardware event for the calling thread, like perf stat does
+// Reports -1 when performance counters are unavailable (non-Linux, or a
+// restrictive perf_event_paranoid setting)
+class perf_counter {
+public:
+  explicit perf_counter(unsigned long long config) : fd(-1) {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    (void)config;
+#endif
+  }
+  ~perf_counter() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+  }
+  void start() {
+#ifdef __linux__
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+  long long stop() {
+#ifdef __linux__
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return count;
+#else
+    return -1;
+#endif
+  }
+
+private:
+  int fd;
+};
+
+/*----------------------------------------*
+ | PRIORITY QUEUE: push throughput & latency
+ *----------------------------------------*/
+
+template<class Queue>
+static void bench_priority_queue(const char* name, const std::vector<int>& input) {
+  Queue queue;
+  std::vector<double> latencies;
+  latencies.reserve(input.size());
+
+  bench_clock::time_point start = bench_clock::now();
+  for (std::size_t i = 0; i < input.size(); ++i) {
+    bench_clock::time_point op_start = bench_clock::now();
+    queue.push(input[i]);
+    latencies.push_back(elapsed_ns(op_start, bench_clock::now()));
+  }
+  while (!queue.empty()) {
+    queue.pop();
+  }
+  double total_ns = elapsed_ns(start, bench_clock::now());
+
+  report(name, total_ns, 2 * input.size(), latencies);
+}
+
+static void bench_priority_queues(std::size_t n) {
+  std::mt19937 rng(42);
+  std::vector<int> input(n);
+  for (std::size_t i = 0; i < n; ++i) input[i] = static_cast<int>(rng());
+
+  std::printf("priority queue, %zu push + %zu pop\n", n, n);
+  bench_priority_queue<std::priority_queue<int>>("std::priority_queue", input);
+  bench_priority_queue<lazy_priority_queue<int>>("lazy_priority_queue (binary)", input);
+  bench_priority_queue<lazy_priority_queue<int, std::less<int>, 4>>(
+      "lazy_priority_queue (4-ary)", input);
+  bench_priority_queue<lazy_priority_queue<int, std::less<int>, 8>>(
+      "lazy_priority_queue (8-ary)", input);
+  std::printf("\n");
+}
+
+/*----------------------------------------*
+ | RING QUEUE: burst push latency & SPSC throughput
+ *----------------------------------------*/
+
+// Pushes in bursts of growing size with partial drains in between, so the
+// queue keeps growing while it also wraps around
+template<class Queue, class Pop>
+static void bench_ring_queue(const char* name, std::size_t n, Pop pop) {
+  Queue queue;
+  std::vector<double> latencies;
+  latencies.reserve(n);
+
+  bench_clock::time_point start = bench_clock::now();
+  std::size_t pushed = 0;
+  for (std::size_t burst = 1; pushed < n; burst *= 2) {
+    for (std::size_t i = 0; i < burst && pushed < n; ++i, ++pushed) {
+      bench_clock::time_point op_start = bench_clock::now();
+      queue.push_back(static_cast<int>(pushed));
+      latencies.push_back(elapsed_ns(op_start, bench_clock::now()));
+    }
+    for (std::size_t i = 0; i < burst / 2; ++i) pop(queue);
+  }
+  double total_ns = elapsed_ns(start, bench_clock::now());
+
+  report(name, total_ns, n, latencies);
+}
+
+static void bench_spsc(std::size_t n, std::size_t batch) {
+  lazy_spsc_ring_queue<int> queue;
+  std::vector<int> input(batch);
+
+  bench_clock::time_point start = bench_clock::now();
+  std::thread producer([&]() {
+    for (std::size_t i = 0; i < n; i += batch) {
+      if (batch == 1) queue.push_back(static_cast<int>(i));
+      else queue.push_n(input.begin(), batch);
+    }
+  });
+  std::vector<int> output(batch);
+  std::size_t popped = 0;
+  while (popped < n) {
+    popped += queue.pop_n(output.begin(), batch);
+  }
+  producer.join();
+  double total_ns = elapsed_ns(start, bench_clock::now());
+
+  std::printf("lazy_spsc_ring_queue, batch %-4zu        %10.2f Mops/s\n",
+              batch, n / (total_ns / 1e3));
+}
+
+static void bench_ring_queues(std::size_t n) {
+  std::printf("ring queue, %zu push_back in growing bursts\n", n);
+  bench_ring_queue<std::deque<int>>("std::deque", n,
+                                    [](std::deque<int>& q) { q.pop_front(); });
+  bench_ring_queue<lazy_ring_queue<int>>("lazy_ring_queue", n,
+                                         [](lazy_ring_queue<int>& q) { q.pop_front(); });
+  bench_spsc(n, 1);
+  bench_spsc(n, 64);
+  std::printf("\n");
+}
+
+/*----------------------------------------*
+ | PUSH_BACK: cache misses per push on vectors larger than the LLC
+ *----------------------------------------*/
+
+template<class Vector>
+static void bench_push_back_misses(const char* name, std::size_t n) {
+#ifdef __linux__
+  perf_counter misses(PERF_COUNT_HW_CACHE_MISSES);
+  perf_counter references(PERF_COUNT_HW_CACHE_REFERENCES);
+#else
+  perf_counter misses(0), references(0);
+#endif
+  Vector vec;
+
+  misses.start();
+  references.start();
+  bench_clock::time_point start = bench_clock::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    vec.push_back(static_cast<int>(i));
+  }
+  double total_ns = elapsed_ns(start, bench_clock::now());
+  long long reference_count = references.stop();
+  long long miss_count = misses.stop();
+
+  if (miss_count < 0) {
+    std::printf("%-40s %10.2f Mops/s   cache misses/push n/a\n",
+                name, n / (total_ns / 1e3));
+  }
+  else {
+    std::printf("%-40s %10.2f Mops/s   cache misses/push %6.3f   references/push %6.3f\n",
+                name, n / (total_ns / 1e3),
+                static_cast<double>(miss_count) / n,
+                static_cast<double>(reference_count) / n);
+  }
+}
+
+static void bench_push_back(std::size_t n) {
+  std::printf("push_back, %zu ints (migration group %d bytes)\n",
+              n, LAZY_VECTOR_MIGRATION_BYTES);
+  bench_push_back_misses<std::vector<int>>("std::vector", n);
+  bench_push_back_misses<lazy_vector<int>>("lazy_vector", n);
+  std::printf("\n");
+}
+
+/*----------------------------------------*
+ | LARGE BUFFERS: page faults per million pushes
+ *----------------------------------------*/
+
+// Returns the minor page faults of this process so far, or -1 if unknown
+static long long minor_page_faults() {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+#else
+  return -1;
+#endif
+}
+
+template<class Vector>
+static void bench_page_faults(const char* name, std::size_t n) {
+  // filled up front, so the latency buffer's own pages are not counted
+  std::vector<double> latencies(n, 0.0);
+  long long faults_before = minor_page_faults();
+  bench_clock::time_point start = bench_clock::now();
+  {
+    Vector vec;
+    for (std::size_t i = 0; i < n; ++i) {
+      bench_clock::time_point op_start = bench_clock::now();
+      vec.push_back(static_cast<int>(i));
+      latencies[i] = elapsed_ns(op_start, bench_clock::now());
+    }
+  }
+  double total_ns = elapsed_ns(start, bench_clock::now());
+  long long faults = minor_page_faults() - faults_before;
+
+  report(name, total_ns, n, latencies);
+  std::printf("%-40s %10.1f page faults per million pushes\n", "",
+              faults * 1e6 / n);
+}
+
+static void bench_large_buffers(std::size_t n) {
+  std::printf("large buffers, %zu push_back of int\n", n);
+  bench_page_faults<std::vector<int>>("std::vector", n);
+  bench_page_faults<lazy_vector<int>>("lazy_vector<std::allocator>", n);
+  bench_page_faults<lazy_vector<int, huge_page_allocator<int>>>(
+      "lazy_vector<huge_page_allocator>", n);
+  std::printf("\n");
+}
+
+/*----------------------------------------*
+ | RANDOM READS: operator[] against std::vector
+ *----------------------------------------*/
+
+template<class Vector>
+static void bench_random_reads(const char* name, const Vector& vec,
+                               const std::vector<std::size_t>& positions) {
+  long long sum = 0;
+  bench_clock::time_point start = bench_clock::now();
+  for (int round = 0; round < 10; ++round) {
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      sum += vec[positions[i]];
+    }
+  }
+  double total_ns = elapsed_ns(start, bench_clock::now());
+  std::size_t reads = 10 * positions.size();
+
+  std::printf("%-40s %10.2f Mreads/s   %6.2f ns/read   (checksum %lld)\n",
+              name, reads / (total_ns / 1e3), total_ns / reads, sum);
+}
+
+static void bench_reads(std::size_t n) {
+  std::mt19937 rng(7);
+  std::vector<std::size_t> positions(1 << 22);
+  for (std::size_t i = 0; i < positions.size(); ++i) positions[i] = rng() % n;
+
+  std::vector<int> std_vec;
+  lazy_vector<int> settled, migrating;
+  for (std::size_t i = 0; i < n; ++i) {
+    std_vec.push_back(static_cast<int>(i));
+    settled.push_back(static_cast<int>(i));
+  }
+  // n + n / 2 elements leave half of head still to be migrated
+  for (std::size_t i = 0; i < n + n / 2; ++i) {
+    migrating.push_back(static_cast<int>(i));
+  }
+
+  std::printf("random reads, %zu positions in %zu elements\n", positions.size(), n);
+  bench_random_reads("std::vector", std_vec, positions);
+  bench_random_reads("lazy_vector (settled)", settled, positions);
+  bench_random_reads("lazy_vector (mid migration)", migrating, positions);
+  std::printf("\n");
+}
+
+int main() {
+  bench_priority_queues(1 << 22);
+  bench_ring_queues(1 << 22);
+  bench_push_back(1 << 25);
+  bench_large_buffers(1 << 26);
+  bench_reads(1 << 16);
+  bench_reads(1 << 24);
+  return 0;
+}
@@ -0,0 +1,162 @@
+
+#ifndef HUGE_PAGE_ALLOCATOR_H_
+#define HUGE_PAGE_ALLOCATOR_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HUGE_PAGE_ALLOCATOR_MMAP 1
+#endif
+
+// An allocator for lazy_vector and friends that is meant for large buffers.
+// Buffers of at least large_threshold bytes are mapped directly with mmap,
+// aligned to huge_page_size and advised with MADV_HUGEPAGE where available,
+// so transparent huge pages back them and first touches fault once per huge
+// page rather than once per 4 KiB page. Such buffers go straight back to the
+// OS with munmap on deallocate. Smaller buffers use std::allocator.
+//
+// It also provides the prefault hook lazy_vector uses to populate the next
+// prefault_bytes of a new tail ahead of the pushes and migration that will
+// write to it, spreading the page faults of a fresh tail over many pushes,
+// and the release hook it uses to hand each prefault_bytes chunk of the old
+// buffer back to the OS as soon as migration has emptied it, rather than when
+// the whole old buffer is freed a growth cycle later.
+template<class T>
+class huge_page_allocator {
+public:
+  typedef T           value_type;
+  typedef T*          pointer;
+  typedef std::size_t size_type;
+
+  template<class U>
+  struct rebind {
+    typedef huge_page_allocator<U> other;
+  };
+
+  // Buffers from this size on are mapped with mmap
+  static const size_type large_threshold = size_type(1) << 22;
+  // Alignment and rounding of mapped buffers
+  static const size_type huge_page_size = size_type(1) << 21;
+  // Granularity at which lazy_vector calls prefault
+  static const size_type prefault_bytes = huge_page_size;
+
+  huge_page_allocator() {}
+  template<class U>
+  huge_page_allocator(const huge_page_allocator<U>&) {}
+
+  // Allocates storage for n objects T - may throw std::bad_alloc
+  pointer allocate(const size_type n);
+  // Releases storage previously returned by allocate(n)
+  void deallocate(pointer p, const size_type n);
+  // Populates the pages of [p, p + bytes) - the range must not hold objects
+  void prefault(void* p, const size_type bytes);
+  // Returns the whole pages within [p, p + bytes) to the OS - the range must
+  // not hold objects. It stays usable, and reads as zeros on the next touch
+  void release(void* p, const size_type bytes);
+
+private:
+  static size_type mapped_length(const size_type n);
+};
+
+template<class T, class U>
+bool operator==(const huge_page_allocator<T>&, const huge_page_allocator<U>&) {
+  return true;
+}
+
+template<class T, class U>
+bool operator!=(const huge_page_allocator<T>&, const huge_page_allocator<U>&) {
+  return false;
+}
+
+/*----------------------------------------*
+ | BEGIN HUGE_PAGE_ALLOCATOR IMPLEMENTATION
+ *----------------------------------------*/
+
+template<class T>
+typename huge_page_allocator<T>::pointer huge_page_allocator<T>::allocate(const size_type n) {
+#ifdef HUGE_PAGE_ALLOCATOR_MMAP
+  if (n * sizeof(T) >= large_threshold) {
+    // over-map by one huge page so the buffer can be aligned to it, then
+    // give the unaligned slack on both sides back
+    const size_type length = mapped_length(n);
+    void* raw = mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+
+    const std::uintptr_t raw_addr = reinterpret_cast<std::uintptr_t>(raw);
+    const std::uintptr_t addr = (raw_addr + huge_page_size - 1) & ~(huge_page_size - 1);
+    if (addr > raw_addr) {
+      munmap(raw, addr - raw_addr);
+    }
+    const size_type trailing = huge_page_size - (addr - raw_addr);
+    if (trailing > 0) {
+      munmap(reinterpret_cast<void*>(addr + length), trailing);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(reinterpret_cast<void*>(addr), length, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<pointer>(addr);
+  }
+#endif
+  return std::allocator<T>().allocate(n);
+}
+
+template<class T>
+void huge_page_allocator<T>::deallocate(pointer p, const size_type n) {
+#ifdef HUGE_PAGE_ALLOCATOR_MMAP
+  if (n * sizeof(T) >= large_threshold) {
+    munmap(p, mapped_length(n));
+    return;
+  }
+#endif
+  std::allocator<T>().deallocate(p, n);
+}
+
+template<class T>
+void huge_page_allocator<T>::prefault(void* p, const size_type bytes) {
+#if defined(HUGE_PAGE_ALLOCATOR_MMAP) && defined(MADV_POPULATE_WRITE)
+  if (madvise(p, bytes, MADV_POPULATE_WRITE) == 0) return;
+#endif
+  // older kernels, or memory that did not come from mmap - write a byte to
+  // every page instead
+  volatile char* bytes_ptr = static_cast<char*>(p);
+  const size_type page_size = 4096;
+  for (size_type offset = 0; offset < bytes; offset += page_size) {
+    bytes_ptr[offset] = 0;
+  }
+}
+
+template<class T>
+void huge_page_allocator<T>::release(void* p, const size_type bytes) {
+#if defined(HUGE_PAGE_ALLOCATOR_MMAP) && defined(MADV_DONTNEED)
+  // only whole pages inside the range - the buffer may share its first and
+  // last page with other allocations when it did not come from mmap
+  const std::uintptr_t page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+  const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(p);
+  const std::uintptr_t first = (begin + page_size - 1) & ~(page_size - 1);
+  const std::uintptr_t last = (begin + bytes) & ~(page_size - 1);
+  if (first < last) {
+    madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+  }
+#else
+  (void)p;
+  (void)bytes;
+#endif
+}
+
+template<class T>
+typename huge_page_allocator<T>::size_type huge_page_allocator<T>::mapped_length(
+    const size_type n) {
+  return (n * sizeof(T) + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+/*-----------------------------------------
+ | END HUGE_PAGE_ALLOCATOR IMPLEMENTATION
+ *----------------------------------------*/
+
+#endif // HUGE_PAGE_ALLOCATOR_H_
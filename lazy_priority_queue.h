@@ -0,0 +1,230 @@
+
+#ifndef LAZY_PRIORITY_QUEUE_H_
+#define LAZY_PRIORITY_QUEUE_H_
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "lazy_vector.h"
+
+// A d-ary max-heap (with respect to Compare) stored in a lazy_vector.
+// Growth of the underlying storage is de-amortized by lazy_vector, so a push
+// never stalls on a full reallocation. The heap is addressed purely by index,
+// which lazy_vector resolves across its head and tail regions.
+template<class T, class Compare = std::less<T>, std::size_t Arity = 2,
+         class Allocator = std::allocator<T>>
+class lazy_priority_queue {
+  static_assert(Arity >= 2, "lazy_priority_queue requires an arity of at least 2");
+public:
+  typedef lazy_vector<T, Allocator>             container_type;
+  typedef Compare                               value_compare;
+  typedef typename container_type::value_type      value_type;
+  typedef typename container_type::reference       reference;
+  typedef typename container_type::const_reference const_reference;
+  typedef typename container_type::size_type       size_type;
+
+  // Construct an empty priority queue
+  explicit lazy_priority_queue(const Compare& comp = Compare());
+  // Construct from the range [first, last) - heapified in linear time
+  template<class InputIt>
+  lazy_priority_queue(InputIt first, InputIt last, const Compare& comp = Compare());
+
+  // Storage
+
+  // Returns the amount of elements in the queue
+  size_type size() const;
+  // Returns 1 if empty, else 0
+  bool empty() const;
+  // Prepares the queue for storing 'reserve_amount' elements
+  void reserve(const size_type reserve_amount);
+
+  // Accessing
+
+  // Returns the element with the highest priority
+  const_reference top() const;
+
+  // Modifying
+
+  // Inserts a new element as a copy of a given value
+  void push(const_reference val);
+  // Removes the element with the highest priority
+  void pop();
+  // Appends the range [first, last) and restores the heap in linear time
+  template<class InputIt>
+  void heapify(InputIt first, InputIt last);
+  // Swap two queues of the same type
+  static void swap(lazy_priority_queue& lhs_queue, lazy_priority_queue& rhs_queue);
+  // Remove all elements
+  void clear();
+
+private:
+  void sift_up(size_type pos);
+  void sift_down(size_type pos);
+  void make_heap();
+
+  static size_type parent(const size_type pos);
+  static size_type first_child(const size_type pos);
+
+  container_type elements;
+  Compare comp;
+};
+
+/*----------------------------------------*
+ | BEGIN LAZY_PRIORITY_QUEUE IMPLEMENTATION
+ *----------------------------------------*/
+
+// LAZY_PRIORITY_QUEUE - PUBLIC METHODS
+
+// LAZY_PRIORITY_QUEUE : CONSTRUCTORS
+template<class T, class Compare, std::size_t Arity, class Allocator>
+lazy_priority_queue<T, Compare, Arity, Allocator>::lazy_priority_queue(const Compare& cmp) :
+    elements(), comp(cmp) {
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+template<class InputIt>
+lazy_priority_queue<T, Compare, Arity, Allocator>::lazy_priority_queue(InputIt first,
+                                                                      InputIt last,
+                                                                      const Compare& cmp) :
+    elements(), comp(cmp) {
+  heapify(first, last);
+}
+
+// LAZY_PRIORITY_QUEUE : CAPACITY
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+typename lazy_priority_queue<T, Compare, Arity, Allocator>::size_type
+lazy_priority_queue<T, Compare, Arity, Allocator>::size() const {
+  return elements.size();
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+bool lazy_priority_queue<T, Compare, Arity, Allocator>::empty() const {
+  return elements.empty();
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::reserve(const size_type reserve_amount) {
+  elements.reserve(reserve_amount);
+}
+
+// LAZY_PRIORITY_QUEUE : ACCESSING METHODS
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+typename lazy_priority_queue<T, Compare, Arity, Allocator>::const_reference
+lazy_priority_queue<T, Compare, Arity, Allocator>::top() const {
+  return elements[0];
+}
+
+// LAZY_PRIORITY_QUEUE : MODIFYING METHODS
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::push(const_reference val) {
+  // push_back only ever migrates the element at the head boundary to the
+  // same index in tail, so all indices stay valid across the call
+  elements.push_back(val);
+  sift_up(elements.size() - 1);
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::pop() {
+  const size_type last = elements.size() - 1;
+  if (last > 0) {
+    using std::swap;
+    swap(elements[0], elements[last]);
+  }
+  elements.pop_back();
+  if (last > 1) {
+    sift_down(0);
+  }
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+template<class InputIt>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::heapify(InputIt first, InputIt last) {
+  for (; first != last; ++first) {
+    elements.push_back(*first);
+  }
+  make_heap();
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::swap(lazy_priority_queue& lhs_queue,
+                                                             lazy_priority_queue& rhs_queue) {
+  using std::swap;
+
+  container_type::swap(lhs_queue.elements, rhs_queue.elements);
+  swap(lhs_queue.comp, rhs_queue.comp);
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::clear() {
+  elements.clear();
+}
+
+// LAZY_PRIORITY_QUEUE PRIVATE METHODS
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::sift_up(size_type pos) {
+  // hole technique: lift the new element out and shift parents down into
+  // the hole, which costs one move per level instead of a full swap
+  value_type val(std::move(elements[pos]));
+  while (pos > 0) {
+    const size_type p = parent(pos);
+    if (!comp(elements[p], val)) break;
+    elements[pos] = std::move(elements[p]);
+    pos = p;
+  }
+  elements[pos] = std::move(val);
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::sift_down(size_type pos) {
+  const size_type n = elements.size();
+  value_type val(std::move(elements[pos]));
+  for (;;) {
+    const size_type child = first_child(pos);
+    if (child >= n) break;
+
+    // pick the highest priority child among the (up to) Arity siblings,
+    // which sit next to each other and usually share a cache line
+    size_type best = child;
+    const size_type child_end = (n - child < Arity) ? n : child + Arity;
+    for (size_type c = child + 1; c < child_end; ++c) {
+      if (comp(elements[best], elements[c])) best = c;
+    }
+    if (!comp(val, elements[best])) break;
+    elements[pos] = std::move(elements[best]);
+    pos = best;
+  }
+  elements[pos] = std::move(val);
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+void lazy_priority_queue<T, Compare, Arity, Allocator>::make_heap() {
+  // Floyd's bottom-up construction - O(n)
+  const size_type n = elements.size();
+  if (n < 2) return;
+  for (size_type pos = parent(n - 1) + 1; pos-- > 0; ) {
+    sift_down(pos);
+  }
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+typename lazy_priority_queue<T, Compare, Arity, Allocator>::size_type
+lazy_priority_queue<T, Compare, Arity, Allocator>::parent(const size_type pos) {
+  return (pos - 1) / Arity;
+}
+
+template<class T, class Compare, std::size_t Arity, class Allocator>
+typename lazy_priority_queue<T, Compare, Arity, Allocator>::size_type
+lazy_priority_queue<T, Compare, Arity, Allocator>::first_child(const size_type pos) {
+  return pos * Arity + 1;
+}
+
+/*-----------------------------------------
+ | END LAZY_PRIORITY_QUEUE IMPLEMENTATION
+ *----------------------------------------*/
+
+#endif // LAZY_PRIORITY_QUEUE_H_
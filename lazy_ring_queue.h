@@ -0,0 +1,583 @@
+
+#ifndef LAZY_RING_QUEUE_H_
+#define LAZY_RING_QUEUE_H_
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+
+// A FIFO queue stored in a circular buffer, so pop_front is O(1) and never
+// shifts elements. Growth follows the lazy_vector scheme: when the buffer is
+// full a new buffer of twice the capacity becomes the tail, and every
+// following push_back migrates one element from the old buffer (head) until
+// it is empty - no single operation ever copies the whole queue.
+template<class T, class Allocator = std::allocator<T>>
+class lazy_ring_queue {
+public:
+  typedef T                 value_type;
+  typedef value_type*       pointer;
+  typedef value_type&       reference;
+  typedef const value_type& const_reference;
+  typedef std::size_t       size_type;
+
+  // Construct an empty lazy_ring_queue
+  lazy_ring_queue();
+  // Move constructor
+  lazy_ring_queue(lazy_ring_queue&& rhs_queue);
+  lazy_ring_queue(const lazy_ring_queue&) = delete;
+  lazy_ring_queue& operator=(const lazy_ring_queue&) = delete;
+
+  ~lazy_ring_queue();
+
+  // Storage
+
+  // Returns the amount of elements in the queue
+  size_type size() const;
+  // Returns the maximum capacity of the queue
+  size_type capacity() const;
+  // Returns 1 if empty, else 0
+  bool empty() const;
+
+  // Accessing
+
+  // Returns the oldest element
+  reference front() const;
+  // Returns the newest element
+  reference back() const;
+
+  // Modifying
+
+  // Inserts a new element at the back, as a copy of a given value
+  void push_back(const_reference val);
+  // Inserts n elements read from first onwards
+  // Grows at most once and writes the elements in contiguous runs
+  template<class InputIt>
+  void push_n(InputIt first, size_type n);
+  // Removes the oldest element
+  void pop_front();
+  // Moves up to n of the oldest elements to out and removes them
+  // Returns the amount of elements removed
+  template<class OutputIt>
+  size_type pop_n(OutputIt out, size_type n);
+  // Swap two queues of the same type
+  static void swap(lazy_ring_queue& lhs_queue, lazy_ring_queue& rhs_queue);
+  // Remove all elements
+  // Capacity remains the same
+  void clear();
+
+private:
+  // A circular region - element i lives at first[(begin + i) & (capacity - 1)]
+  typedef struct {
+    pointer first;
+    size_type begin;
+    size_type size;
+    size_type capacity;
+  } ring_region;
+
+  void extend(const size_type min_capacity = 0);
+  void migrate(const size_type n);
+
+  static reference slot(const ring_region& region, const size_type i);
+  template<class OutputIt>
+  static size_type drain_region(ring_region& region, OutputIt& out, size_type n);
+  static void destroy_region(ring_region& region);
+
+  // head holds the oldest elements, tail the newest
+  ring_region head, tail;
+  static const size_type default_capacity;
+  static Allocator allocator;
+};
+
+// A single producer, single consumer variant of lazy_ring_queue that is
+// lock-free. Instead of migrating elements, growth links a new ring of twice
+// the capacity after the current one: the producer continues in the new ring
+// and the consumer switches over once it has drained the old one, so neither
+// side ever copies existing elements.
+//
+// push_back and push_n may only be called from the producer thread,
+// try_pop_front, pop_n, size and empty only from the consumer thread.
+template<class T, class Allocator = std::allocator<T>>
+class lazy_spsc_ring_queue {
+public:
+  typedef T                 value_type;
+  typedef value_type*       pointer;
+  typedef value_type&       reference;
+  typedef const value_type& const_reference;
+  typedef std::size_t       size_type;
+
+  // Construct an empty lazy_spsc_ring_queue
+  lazy_spsc_ring_queue();
+  lazy_spsc_ring_queue(const lazy_spsc_ring_queue&) = delete;
+  lazy_spsc_ring_queue& operator=(const lazy_spsc_ring_queue&) = delete;
+
+  ~lazy_spsc_ring_queue();
+
+  // Producer side
+
+  // Inserts a new element at the back, as a copy of a given value
+  void push_back(const_reference val);
+  // Inserts n elements read from first onwards, publishing them in batches
+  template<class InputIt>
+  void push_n(InputIt first, size_type n);
+
+  // Consumer side
+
+  // Moves the oldest element to out and removes it
+  // Returns 0 if the queue was empty, else 1
+  bool try_pop_front(reference out);
+  // Moves up to n of the oldest elements to out and removes them
+  // Returns the amount of elements removed
+  template<class OutputIt>
+  size_type pop_n(OutputIt out, size_type n);
+  // Returns the amount of elements published by the producer so far
+  size_type size() const;
+  // Returns 1 if no published elements are left, else 0
+  bool empty() const;
+
+private:
+  static const size_type cache_line_size = 64;
+
+  // write_pos and read_pos grow monotonically, the slot of a position is
+  // pos & (capacity - 1). Both sides keep a cached copy of the other side's
+  // position so that the shared cache line is only touched when needed.
+  // Padding keeps the producer and consumer fields on separate cache lines
+  // (explicit rather than alignas, since operator new ignores extended
+  // alignment before C++17)
+  struct segment {
+    explicit segment(const size_type cap);
+
+    pointer first;
+    size_type capacity;
+    std::atomic<segment*> next;
+    char pad_0[cache_line_size];
+
+    std::atomic<size_type> write_pos;
+    size_type cached_read; // producer only
+    char pad_1[cache_line_size];
+
+    std::atomic<size_type> read_pos;
+    size_type cached_write; // consumer only
+  };
+
+  segment* grow();
+  segment* next_readable(segment* seg);
+
+  segment* producer_segment;
+  char pad[cache_line_size];
+  segment* consumer_segment;
+  static const size_type default_capacity;
+  static Allocator allocator;
+};
+
+/*----------------------------------------*
+ | BEGIN LAZY_RING_QUEUE IMPLEMENTATION
+ *----------------------------------------*/
+
+// LAZY_RING_QUEUE - PUBLIC METHODS
+
+// LAZY_RING_QUEUE : CONSTRUCTOR & DESTRUCTOR METHODS
+template<class T, class Allocator>
+lazy_ring_queue<T, Allocator>::lazy_ring_queue() : head() {
+  pointer tail_array = static_cast<pointer>(allocator.allocate(default_capacity));
+  tail = { tail_array, 0, 0, default_capacity };
+}
+
+template<class T, class Allocator>
+lazy_ring_queue<T, Allocator>::lazy_ring_queue(lazy_ring_queue&& rhs_queue) :
+    head(rhs_queue.head), tail(rhs_queue.tail) {
+  //remove ownership from rhs_queue
+  rhs_queue.head = rhs_queue.tail = { nullptr, 0, 0, 0 };
+}
+
+template<class T, class Allocator>
+lazy_ring_queue<T, Allocator>::~lazy_ring_queue() {
+  clear();
+
+  if (head.capacity > 0) {
+    allocator.deallocate(head.first, head.capacity);
+  }
+  if (tail.capacity > 0) {
+    allocator.deallocate(tail.first, tail.capacity);
+  }
+}
+
+// LAZY_RING_QUEUE : CAPACITY
+
+template<class T, class Allocator>
+typename lazy_ring_queue<T, Allocator>::size_type lazy_ring_queue<T, Allocator>::size() const {
+  return head.size + tail.size;
+}
+
+template<class T, class Allocator>
+typename lazy_ring_queue<T, Allocator>::size_type lazy_ring_queue<T, Allocator>::capacity() const {
+  return tail.capacity;
+}
+
+template<class T, class Allocator>
+bool lazy_ring_queue<T, Allocator>::empty() const {
+  return size() == 0;
+}
+
+// LAZY_RING_QUEUE : ACCESSING METHODS
+
+template<class T, class Allocator>
+typename lazy_ring_queue<T, Allocator>::reference lazy_ring_queue<T, Allocator>::front() const {
+  if (head.size > 0) return slot(head, 0);
+  return slot(tail, 0);
+}
+
+template<class T, class Allocator>
+typename lazy_ring_queue<T, Allocator>::reference lazy_ring_queue<T, Allocator>::back() const {
+  if (tail.size > 0) return slot(tail, tail.size - 1);
+  return slot(head, head.size - 1);
+}
+
+// LAZY_RING_QUEUE : MODIFYING METHODS
+
+template<class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::push_back(const_reference val) {
+  // head always satisfies 2 * head.size + tail.size <= tail.capacity, so
+  // head is empty by the time tail is full
+  if (head.size + tail.size >= tail.capacity) {
+    extend();
+  }
+  if (head.size > 0) {
+    migrate(1);
+  }
+  new (&slot(tail, tail.size)) value_type(val);
+  ++tail.size;
+}
+
+template<class T, class Allocator>
+template<class InputIt>
+void lazy_ring_queue<T, Allocator>::push_n(InputIt first, size_type n) {
+  while (n > 0) {
+    // a batch of k pushes migrates min(k, head.size) elements, so it fits in
+    // tail as long as k <= room. Filling room always drains head, so growth
+    // is needed at most once, and then sized for everything left
+    size_type room = tail.capacity - tail.size - head.size;
+    if (room == 0) {
+      extend(size() + n);
+      room = tail.capacity - tail.size - head.size;
+    }
+    const size_type batch = n < room ? n : room;
+    migrate(batch < head.size ? batch : head.size);
+
+    size_type remaining = batch;
+    while (remaining > 0) {
+      // construct the contiguous run up to the physical end of the buffer
+      const size_type end = (tail.begin + tail.size) & (tail.capacity - 1);
+      size_type run = tail.capacity - end;
+      if (run > remaining) run = remaining;
+      pointer dest = tail.first + end;
+      for (size_type i = 0; i < run; ++i, ++first) {
+        new (dest + i) value_type(*first);
+      }
+      tail.size += run;
+      remaining -= run;
+    }
+    n -= batch;
+  }
+}
+
+template<class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::pop_front() {
+  // head holds the oldest elements - pop from it until it is drained
+  ring_region& region = (head.size > 0) ? head : tail;
+  slot(region, 0).~value_type();
+  region.begin = (region.begin + 1) & (region.capacity - 1);
+  --region.size;
+}
+
+template<class T, class Allocator>
+template<class OutputIt>
+typename lazy_ring_queue<T, Allocator>::size_type lazy_ring_queue<T, Allocator>::pop_n(
+    OutputIt out, size_type n) {
+  size_type popped = drain_region(head, out, n);
+  popped += drain_region(tail, out, n - popped);
+  return popped;
+}
+
+template <class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::swap(lazy_ring_queue& lhs_queue,
+                                         lazy_ring_queue& rhs_queue) {
+  using std::swap;
+
+  swap(lhs_queue.head, rhs_queue.head);
+  swap(lhs_queue.tail, rhs_queue.tail);
+}
+
+template<class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::clear() {
+  destroy_region(head);
+  destroy_region(tail);
+}
+
+// LAZY_RING_QUEUE PRIVATE METHODS
+
+//head.size must be 0
+template<class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::extend(const size_type min_capacity) {
+  //all values T in head have been destructed or migrated
+  //free the memory
+  if (head.capacity > 0) {
+    allocator.deallocate(head.first, head.capacity);
+  }
+
+  head = tail; // head becomes tail
+  // tail may now be overwritten
+
+  size_type new_capacity = head.capacity > 0 ? head.capacity * 2 : default_capacity;
+  while (new_capacity < min_capacity) {
+    new_capacity *= 2;
+  }
+  pointer tail_array = static_cast<pointer>(allocator.allocate(new_capacity));
+  tail = { tail_array, 0, 0, new_capacity };
+}
+
+//head.size must be >= n
+template<class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::migrate(const size_type n) {
+  // the n newest elements in head become the oldest in tail, which keeps
+  // FIFO order since everything already in tail was pushed after them
+  tail.begin = (tail.begin - n) & (tail.capacity - 1);
+  for (size_type i = 0; i < n; ++i) {
+    reference old_element = slot(head, head.size - n + i);
+    new (&slot(tail, i)) value_type(std::move(old_element));
+    old_element.~value_type();
+  }
+  tail.size += n;
+  head.size -= n;
+}
+
+template<class T, class Allocator>
+typename lazy_ring_queue<T, Allocator>::reference lazy_ring_queue<T, Allocator>::slot(
+    const ring_region& region, const size_type i) {
+  return region.first[(region.begin + i) & (region.capacity - 1)];
+}
+
+template<class T, class Allocator>
+template<class OutputIt>
+typename lazy_ring_queue<T, Allocator>::size_type lazy_ring_queue<T, Allocator>::drain_region(
+    ring_region& region, OutputIt& out, size_type n) {
+  if (n > region.size) n = region.size;
+  size_type remaining = n;
+  while (remaining > 0) {
+    // move out the contiguous run up to the physical end of the buffer
+    size_type run = region.capacity - region.begin;
+    if (run > remaining) run = remaining;
+    pointer first = region.first + region.begin;
+    for (size_type i = 0; i < run; ++i) {
+      *out = std::move(first[i]);
+      ++out;
+      first[i].~value_type();
+    }
+    region.begin = (region.begin + run) & (region.capacity - 1);
+    region.size -= run;
+    remaining -= run;
+  }
+  return n;
+}
+
+template<class T, class Allocator>
+void lazy_ring_queue<T, Allocator>::destroy_region(ring_region& region) {
+  for (size_type i = 0; i < region.size; ++i) {
+    slot(region, i).~value_type();
+  }
+  region.begin = region.size = 0;
+}
+
+template<class T, class Allocator>
+const typename lazy_ring_queue<T, Allocator>::size_type
+lazy_ring_queue<T, Allocator>::default_capacity = 1 << 4;
+
+template<class T, class Allocator>
+Allocator lazy_ring_queue<T, Allocator>::allocator;
+
+/*-----------------------------------------
+ | END LAZY_RING_QUEUE IMPLEMENTATION
+ *----------------------------------------*/
+
+/*----------------------------------------*
+ | BEGIN LAZY_SPSC_RING_QUEUE IMPLEMENTATION
+ *----------------------------------------*/
+
+// LAZY_SPSC_RING_QUEUE : CONSTRUCTOR & DESTRUCTOR METHODS
+template<class T, class Allocator>
+lazy_spsc_ring_queue<T, Allocator>::lazy_spsc_ring_queue() {
+  producer_segment = consumer_segment = new segment(default_capacity);
+}
+
+template<class T, class Allocator>
+lazy_spsc_ring_queue<T, Allocator>::~lazy_spsc_ring_queue() {
+  // both threads must be done with the queue at this point
+  segment* seg = consumer_segment;
+  while (seg) {
+    const size_type write = seg->write_pos.load(std::memory_order_relaxed);
+    for (size_type pos = seg->read_pos.load(std::memory_order_relaxed); pos != write; ++pos) {
+      seg->first[pos & (seg->capacity - 1)].~value_type();
+    }
+    segment* next = seg->next.load(std::memory_order_relaxed);
+    allocator.deallocate(seg->first, seg->capacity);
+    delete seg;
+    seg = next;
+  }
+}
+
+// LAZY_SPSC_RING_QUEUE : PRODUCER METHODS
+
+template<class T, class Allocator>
+void lazy_spsc_ring_queue<T, Allocator>::push_back(const_reference val) {
+  segment* seg = producer_segment;
+  size_type write = seg->write_pos.load(std::memory_order_relaxed);
+  if (write - seg->cached_read == seg->capacity) {
+    seg->cached_read = seg->read_pos.load(std::memory_order_acquire);
+    if (write - seg->cached_read == seg->capacity) {
+      seg = grow();
+      write = 0;
+    }
+  }
+  new (seg->first + (write & (seg->capacity - 1))) value_type(val);
+  seg->write_pos.store(write + 1, std::memory_order_release);
+}
+
+template<class T, class Allocator>
+template<class InputIt>
+void lazy_spsc_ring_queue<T, Allocator>::push_n(InputIt first, size_type n) {
+  while (n > 0) {
+    segment* seg = producer_segment;
+    size_type write = seg->write_pos.load(std::memory_order_relaxed);
+    size_type free_slots = seg->capacity - (write - seg->cached_read);
+    if (free_slots < n) {
+      seg->cached_read = seg->read_pos.load(std::memory_order_acquire);
+      free_slots = seg->capacity - (write - seg->cached_read);
+      if (free_slots == 0) {
+        seg = grow();
+        write = 0;
+        free_slots = seg->capacity;
+      }
+    }
+    // construct the whole batch, then publish it with a single store
+    const size_type batch = (free_slots < n) ? free_slots : n;
+    for (size_type i = 0; i < batch; ++i, ++first) {
+      new (seg->first + ((write + i) & (seg->capacity - 1))) value_type(*first);
+    }
+    seg->write_pos.store(write + batch, std::memory_order_release);
+    n -= batch;
+  }
+}
+
+// LAZY_SPSC_RING_QUEUE : CONSUMER METHODS
+
+template<class T, class Allocator>
+bool lazy_spsc_ring_queue<T, Allocator>::try_pop_front(reference out) {
+  segment* seg = next_readable(consumer_segment);
+  if (!seg) return false;
+
+  const size_type read = seg->read_pos.load(std::memory_order_relaxed);
+  pointer element = seg->first + (read & (seg->capacity - 1));
+  out = std::move(*element);
+  element->~value_type();
+  seg->read_pos.store(read + 1, std::memory_order_release);
+  return true;
+}
+
+template<class T, class Allocator>
+template<class OutputIt>
+typename lazy_spsc_ring_queue<T, Allocator>::size_type lazy_spsc_ring_queue<T, Allocator>::pop_n(
+    OutputIt out, size_type n) {
+  size_type popped = 0;
+  while (popped < n) {
+    segment* seg = next_readable(consumer_segment);
+    if (!seg) break;
+
+    // take everything known to be published, then release the slots at once
+    const size_type read = seg->read_pos.load(std::memory_order_relaxed);
+    size_type batch = seg->cached_write - read;
+    if (batch > n - popped) batch = n - popped;
+    for (size_type i = 0; i < batch; ++i) {
+      pointer element = seg->first + ((read + i) & (seg->capacity - 1));
+      *out = std::move(*element);
+      ++out;
+      element->~value_type();
+    }
+    seg->read_pos.store(read + batch, std::memory_order_release);
+    popped += batch;
+  }
+  return popped;
+}
+
+template<class T, class Allocator>
+typename lazy_spsc_ring_queue<T, Allocator>::size_type
+lazy_spsc_ring_queue<T, Allocator>::size() const {
+  size_type total = 0;
+  for (segment* seg = consumer_segment; seg; seg = seg->next.load(std::memory_order_acquire)) {
+    total += seg->write_pos.load(std::memory_order_acquire) -
+             seg->read_pos.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+template<class T, class Allocator>
+bool lazy_spsc_ring_queue<T, Allocator>::empty() const {
+  return size() == 0;
+}
+
+// LAZY_SPSC_RING_QUEUE PRIVATE METHODS
+
+template<class T, class Allocator>
+lazy_spsc_ring_queue<T, Allocator>::segment::segment(const size_type cap) :
+    first(static_cast<pointer>(allocator.allocate(cap))), capacity(cap), next(nullptr),
+    write_pos(0), cached_read(0), read_pos(0), cached_write(0) {
+}
+
+// called by the producer when producer_segment is full
+template<class T, class Allocator>
+typename lazy_spsc_ring_queue<T, Allocator>::segment* lazy_spsc_ring_queue<T, Allocator>::grow() {
+  segment* seg = new segment(producer_segment->capacity * 2);
+  // the producer never writes to the old segment again, which is what allows
+  // the consumer to release it once it has seen this link
+  producer_segment->next.store(seg, std::memory_order_release);
+  producer_segment = seg;
+  return seg;
+}
+
+// called by the consumer - returns the segment holding the oldest element,
+// releasing drained segments on the way, or nullptr if nothing is published
+template<class T, class Allocator>
+typename lazy_spsc_ring_queue<T, Allocator>::segment*
+lazy_spsc_ring_queue<T, Allocator>::next_readable(segment* seg) {
+  for (;;) {
+    const size_type read = seg->read_pos.load(std::memory_order_relaxed);
+    if (read != seg->cached_write) return seg;
+
+    seg->cached_write = seg->write_pos.load(std::memory_order_acquire);
+    if (read != seg->cached_write) return seg;
+
+    segment* next = seg->next.load(std::memory_order_acquire);
+    if (!next) return nullptr;
+
+    // the producer may have published more before linking next
+    seg->cached_write = seg->write_pos.load(std::memory_order_acquire);
+    if (read != seg->cached_write) return seg;
+
+    consumer_segment = next;
+    allocator.deallocate(seg->first, seg->capacity);
+    delete seg;
+    seg = next;
+  }
+}
+
+template<class T, class Allocator>
+const typename lazy_spsc_ring_queue<T, Allocator>::size_type
+lazy_spsc_ring_queue<T, Allocator>::default_capacity = 1 << 4;
+
+template<class T, class Allocator>
+Allocator lazy_spsc_ring_queue<T, Allocator>::allocator;
+
+/*-----------------------------------------
+ | END LAZY_SPSC_RING_QUEUE IMPLEMENTATION
+ *----------------------------------------*/
+
+#endif // LAZY_RING_QUEUE_H_
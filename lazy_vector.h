@@ -3,12 +3,93 @@
 #define LAZY_VECTOR_H_
 
 #include <initializer_list>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <utility>
 
+// Amount of bytes migrated from head to tail at a time. Once every
+// LAZY_VECTOR_MIGRATION_BYTES / sizeof(T) pushes, that many elements are
+// moved together, so each migration reads and writes whole cache lines
+// instead of touching a head and a tail line on every push.
+// Define as 1 to migrate a single element per push
+#ifndef LAZY_VECTOR_MIGRATION_BYTES
+#define LAZY_VECTOR_MIGRATION_BYTES 64
+#endif
+
+// How many migration groups ahead to prefetch
+#ifndef LAZY_VECTOR_PREFETCH_DISTANCE
+#define LAZY_VECTOR_PREFETCH_DISTANCE 4
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LAZY_VECTOR_PREFETCH(addr, rw) __builtin_prefetch((addr), (rw))
+#else
+#define LAZY_VECTOR_PREFETCH(addr, rw) ((void)(addr))
+#endif
+
+// Define LAZY_VECTOR_CHECKED to verify the head/tail invariants after every
+// mutating operation, aborting with a message on the first violation. Pair it
+// with tracking_allocator.h to also catch leaked or double freed buffers.
+// Without it the checks compile to nothing
+#ifdef LAZY_VECTOR_CHECKED
+#include <cstdio>
+#define LAZY_VECTOR_CHECK_INVARIANTS() check_invariants()
+#define LAZY_VECTOR_CHECK(cond)                                                  \
+  do {                                                                           \
+    if (!(cond)) {                                                               \
+      std::fprintf(stderr, "%s:%d: lazy_vector invariant violated: %s\n",        \
+                   __FILE__, __LINE__, #cond);                                   \
+      std::abort();                                                              \
+    }                                                                            \
+  } while (0)
+#else
+#define LAZY_VECTOR_CHECK_INVARIANTS() ((void)0)
+#endif
+
+// Optional allocator hook: an Allocator with a static prefault_bytes member and
+// a prefault(void* p, size_t bytes) method gets asked to populate the pages of
+// a new tail ahead of the migration and push_back frontiers, one
+// prefault_bytes chunk at a time (see huge_page_allocator.h). If it also has a
+// release(void* p, size_t bytes) method, each prefault_bytes chunk of head is
+// handed to release as soon as the migration frontier has moved below it, so
+// migrated pages need not stay resident until head is freed
+template<class>
+struct lazy_vector_void {
+  typedef void type;
+};
+
+template<class Allocator, class = void>
+struct lazy_vector_prefault_traits {
+  static const std::size_t stride = 0;
+  static void prefault(Allocator&, void*, std::size_t) {}
+};
+
+template<class Allocator>
+struct lazy_vector_prefault_traits<Allocator,
+    typename lazy_vector_void<decltype(Allocator::prefault_bytes)>::type> {
+  static const std::size_t stride = Allocator::prefault_bytes;
+  static void prefault(Allocator& allocator, void* p, std::size_t bytes) {
+    allocator.prefault(p, bytes);
+  }
+};
+
+template<class Allocator, class = void>
+struct lazy_vector_release_traits {
+  static void release(Allocator&, void*, std::size_t) {}
+};
+
+template<class Allocator>
+struct lazy_vector_release_traits<Allocator,
+    typename lazy_vector_void<decltype(std::declval<Allocator&>().release(
+        static_cast<void*>(nullptr), std::size_t()))>::type> {
+  static void release(Allocator& allocator, void* p, std::size_t bytes) {
+    allocator.release(p, bytes);
+  }
+};
+
 template<class T, class Allocator = std::allocator<T>>
 class lazy_vector {
 public:
@@ -64,20 +145,47 @@ public:
   // Accessing
 
   // Returns the element at a given position - may throw std::out_of_range
-  reference at(const size_type pos) const;
+  reference at(const size_type pos);
+  const_reference at(const size_type pos) const;
   // Returns the element at a given position - does not throw an exception
-  reference operator[](const size_type pos) const;
+  reference operator[](const size_type pos);
+  const_reference operator[](const size_type pos) const;
   // Returns the first element
-  reference front() const;
+  reference front();
+  const_reference front() const;
   // Returns the last element
-  reference back() const;
+  reference back();
+  const_reference back() const;
 
   // Modifying
 
   // Inserts a new element at the end, as a copy of a given value
   void push_back(const_reference val);
-  // Removes the last element and returns a copy of it
-  value_type pop_back();
+  // Removes the last element
+  void pop_back();
+  // Moves the last element into out and removes it
+  void pop_back_into(reference out);
+  // Removes the last element and returns it, moved rather than copied
+  value_type take_back();
+  // Moves the last n elements (fewer if the container is smaller) to out,
+  // in order, and removes them in one step. Returns the amount moved
+  template<class OutputIt>
+  size_type drain(size_type n, OutputIt out);
+  // Inserts a copy of val before pos, returns an iterator to the new element
+  iterator insert(iterator pos, const_reference val);
+  // Inserts copies of [first, last) before pos, returns an iterator to the
+  // first inserted element
+  template<class InputIt>
+  iterator insert(iterator pos, InputIt first, InputIt last);
+  // Removes the element at pos, returns an iterator to the element after it
+  iterator erase(iterator pos);
+  // Removes the elements in [first, last), returns an iterator to the
+  // element after the removed range
+  iterator erase(iterator first, iterator last);
+  // Removes every element for which pred returns true in a single pass,
+  // keeping the order of the others. Returns the amount removed
+  template<class Predicate>
+  size_type erase_if(Predicate pred);
   // Swap two vectors of the same type
   static void swap(lazy_vector<T, Allocator>& lhs_vec, lazy_vector<T, Allocator>& rhs_vec);
   // Remove all elements
@@ -117,7 +225,17 @@ private:
   void extend();
   void shorten();
 
-  void empty_head();
+  void check_invariants() const;
+  pointer address(const size_type pos) const;
+  void migrate(const size_type n);
+  void prefault_tail(const size_type old_first, const size_type new_first);
+  void release_head(const size_type old_first, const size_type new_first);
+  void migrate_back(const size_type n);
+  // removes the last n elements with a single shrink step, passing each one
+  // to consume before it is destroyed
+  template<class Consume>
+  void erase_back(const size_type n, Consume consume);
+  void reverse(size_type first, size_type last);
   bool lazy() const;
 
   typedef struct {
@@ -128,6 +246,7 @@ private:
 
   mem_region head, tail;
   static const size_t default_capacity;
+  static const size_type migration_group;
   static Allocator allocator;
 };
 
@@ -142,6 +261,7 @@ template<class T, class Allocator>
 lazy_vector<T, Allocator>::lazy_vector() : head() {
   pointer tail_array = static_cast<pointer>(allocator.allocate(default_capacity));
   tail = { tail_array, 0, default_capacity };
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 template<class T, class Allocator>
@@ -154,6 +274,7 @@ lazy_vector<T, Allocator>::lazy_vector(const size_type n, const_reference val) :
   for (size_type i = 0; i < n; ++i) {
     new (tail.first + i) value_type(val);
   }
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 template<class T, class Allocator>
@@ -170,24 +291,30 @@ lazy_vector<T, Allocator>::lazy_vector(const std::initializer_list<T>& list) : h
   for (const auto item : list) {
     new (tail.first + (i++)) value_type(item);
   }
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 template<class T, class Allocator>
 lazy_vector<T, Allocator>::lazy_vector(const lazy_vector& rhs_vec) : head(rhs_vec.head),
                                                                      tail(rhs_vec.tail) {
-  //alloc for new head & tail
+  //alloc for new head & tail - never share a buffer with rhs_vec, even an
+  //empty one, as both vectors release what they hold
   if (head.size > 0) {
     head.first = static_cast<pointer>(allocator.allocate(head.capacity));
-    std::memcpy(head.first, 
-                rhs_vec.head.first,
-                head.size * sizeof(value_type));
+    for (size_type i = 0; i < head.size; ++i) {
+      new (head.first + i) value_type(rhs_vec.head.first[i]);
+    }
   }
-  if (tail.size > 0) { 
+  else {
+    head = { nullptr, 0, 0 };
+  }
+  if (tail.capacity > 0) {
     tail.first = static_cast<pointer>(allocator.allocate(tail.capacity));
-    std::memcpy(tail.first + head.size,
-                rhs_vec.tail.first + head.size,
-                tail.size * sizeof(value_type));
+    for (size_type i = head.size; i < head.size + tail.size; ++i) {
+      new (tail.first + i) value_type(rhs_vec.tail.first[i]);
+    }
   }
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 template<class T, class Allocator>
@@ -195,6 +322,7 @@ lazy_vector<T, Allocator>::lazy_vector(lazy_vector&& rhs_vec) : head(rhs_vec.hea
                                                                 tail(rhs_vec.tail) {
   //remove ownership from rhs_vec
   rhs_vec.head = rhs_vec.tail = { nullptr , 0, 0 };
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 // LAZY_VECTOR : DESTRUCTOR
@@ -252,18 +380,29 @@ bool lazy_vector<T, Allocator>::empty() const {
 
 template<class T, class Allocator>
 void lazy_vector<T, Allocator>::reserve(const size_type reserve_amount) {
-  if (reserve_amount > capacity()) {
-    empty_head();
-    if (head.first) {
-      allocator.deallocate(head.first, head.capacity);
-    }
-  }
-  head = tail;
-  // tail can now be overwritten
-  size_type new_capacity = head.capacity;
+  if (reserve_amount <= capacity()) return;
+
+  // reserving is asked for up front, so unlike growth through push_back it
+  // relocates every element at once and leaves no migration behind
+  size_type new_capacity = capacity() > 0 ? capacity() : default_capacity;
   while (reserve_amount >= new_capacity) new_capacity <<= 1;
   pointer tail_array = static_cast<pointer>(allocator.allocate(new_capacity));
-  tail = { tail_array, 0, new_capacity };
+
+  const size_type n = size();
+  for (size_type i = 0; i < n; ++i) {
+    pointer old_element = address(i);
+    new (tail_array + i) value_type(std::move(*old_element));
+    old_element->~value_type();
+  }
+  if (head.capacity > 0) {
+    allocator.deallocate(head.first, head.capacity);
+  }
+  if (tail.capacity > 0) {
+    allocator.deallocate(tail.first, tail.capacity);
+  }
+  head = { nullptr, 0, 0 };
+  tail = { tail_array, n, new_capacity };
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 // LAZY_VECTOR : ITERATORS METHODS
@@ -275,7 +414,7 @@ typename lazy_vector<T, Allocator>::iterator lazy_vector<T, Allocator>::begin()
   pointer tail_last = tail.first + head.size + tail.size - 1;
 
   pointer current_ptr;
-  if (lazy()) current_ptr = head.first;
+  if (head.size > 0) current_ptr = head.first;
   else current_ptr = tail_first;
   return iterator(current_ptr, head.first, head_last,
                                tail_first, tail_last);
@@ -294,38 +433,54 @@ typename lazy_vector<T, Allocator>::iterator lazy_vector<T, Allocator>::end() co
 // LAZY_VECTOR : ACCESSING METHODS
 template<class T, class Allocator>
 typename lazy_vector<T, Allocator>::reference lazy_vector<T, Allocator>::at(
+    const size_type pos) {
+  // possibly throw out of range exception
+  if (pos >= size())
+    throw std::out_of_range("lazy_vector.at() access out of range");
+  return *address(pos);
+}
+
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::const_reference lazy_vector<T, Allocator>::at(
     const size_type pos) const {
   // possibly throw out of range exception
   if (pos >= size())
     throw std::out_of_range("lazy_vector.at() access out of range");
-  if (pos >= head.size) {
-    return tail.first[pos];
-  }
-  else {
-    return head.first[pos];
-  }
+  return *address(pos);
 }
 
 template<class T, class Allocator>
 typename lazy_vector<T, Allocator>::reference lazy_vector<T, Allocator>::operator[](
+    const size_type pos) {
+  // no throw
+  return *address(pos);
+}
+
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::const_reference lazy_vector<T, Allocator>::operator[](
     const size_type pos) const {
   // no throw
-  if (pos >= head.size) {
-    return tail.first[pos];
-  }
-  else {
-    return head.first[pos];
-  }
+  return *address(pos);
+}
+
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::reference lazy_vector<T, Allocator>::front() {
+  return *address(0);
+}
+
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::const_reference lazy_vector<T, Allocator>::front() const {
+  return *address(0);
 }
 
 template<class T, class Allocator>
-typename lazy_vector<T, Allocator>::reference lazy_vector<T, Allocator>::front() const {
-  return *begin();
+typename lazy_vector<T, Allocator>::reference lazy_vector<T, Allocator>::back() {
+  return *address(head.size + tail.size - 1);
 }
 
 template<class T, class Allocator>
-typename lazy_vector<T, Allocator>::reference lazy_vector<T, Allocator>::back() const {
-  return *(end() - 1);
+typename lazy_vector<T, Allocator>::const_reference lazy_vector<T, Allocator>::back() const {
+  return *address(head.size + tail.size - 1);
 }
 
 // LAZY_VECTOR : MODIFYING METHODS
@@ -335,42 +490,145 @@ void lazy_vector<T, Allocator>::push_back(const_reference val) {
   if (head.size + tail.size >= tail.capacity) {
     extend();
   }
-  if (lazy()) {
-    //lazy copy 1 item from head to tail using copy constructor
-    new (&tail.first[head.size - 1]) value_type(head.first[head.size - 1]);
-    ++tail.size;
-    //explicitly destruct unused T in head
-    head.first[head.size - 1].~value_type();
-    --head.size;
-  }
+  const bool migrating = lazy();
   //construct new T in tail - using placement new
+  //this comes before the migration, which moves from head elements that
+  //val may refer to. Migration keeps every position, so the slot is the same
   new (&tail.first[head.size + tail.size]) value_type(val);
   ++tail.size;
+  if (migrating) {
+    //lazy move of a group of items from head to tail
+    //2 * head.size + tail.size then stays below capacity for the next
+    //migration_group - 1 pushes, which skip migrating
+    migrate(head.size < migration_group ? head.size : migration_group);
+  }
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 template<class T, class Allocator>
-typename lazy_vector<T, Allocator>::value_type lazy_vector<T, Allocator>::pop_back() {
-  reference element_at_back = *(this->end() - 1);
+void lazy_vector<T, Allocator>::pop_back() {
   if (lazy()) {
-    // move 1 item from tail to head using copy constructor
-    reference old_element = *(tail.first + head.size);
-    new (head.first + head.size) value_type(old_element);
-    old_element.~value_type();
-    ++head.size;
-    --tail.size;
-  }
-  value_type tmp = element_at_back;
-  element_at_back.~value_type();
+    // undo one step of the migration so head keeps up with the shrinking tail
+    migrate_back(1);
+  }
+  tail.first[head.size + tail.size - 1].~value_type();
   --tail.size;
 
-  if (tail.size == 0) {
+  // only fall back to head when it is in use - otherwise keep the
+  // (now empty) tail buffer so that the next push_back has room
+  if (tail.size == 0 && head.capacity > 0) {
     shorten();
   }
+  LAZY_VECTOR_CHECK_INVARIANTS();
+}
+
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::pop_back_into(reference out) {
+  out = std::move(tail.first[head.size + tail.size - 1]);
+  pop_back();
+}
 
-  // return as a copy
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::value_type lazy_vector<T, Allocator>::take_back() {
+  value_type tmp(std::move(tail.first[head.size + tail.size - 1]));
+  pop_back();
   return tmp;
 }
 
+template<class T, class Allocator>
+template<class OutputIt>
+typename lazy_vector<T, Allocator>::size_type lazy_vector<T, Allocator>::drain(
+    size_type n, OutputIt out) {
+  if (n > size()) n = size();
+  if (n == 0) return 0;
+
+  erase_back(n, [&out](reference element) {
+    *out = std::move(element);
+    ++out;
+  });
+  LAZY_VECTOR_CHECK_INVARIANTS();
+  return n;
+}
+
+// Elements may live in either head or tail, so the positional operations below
+// shift by index through operator[] rather than by pointer
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::iterator lazy_vector<T, Allocator>::insert(
+    iterator pos, const_reference val) {
+  const size_type index = pos - begin();
+  // push_back constructs the new element before it migrates anything, so val
+  // may refer to an element of *this
+  push_back(val);
+  value_type tmp(std::move((*this)[size() - 1]));
+  for (size_type i = size() - 1; i > index; --i) {
+    (*this)[i] = std::move((*this)[i - 1]);
+  }
+  (*this)[index] = std::move(tmp);
+  LAZY_VECTOR_CHECK_INVARIANTS();
+  return begin() + index;
+}
+
+template<class T, class Allocator>
+template<class InputIt>
+typename lazy_vector<T, Allocator>::iterator lazy_vector<T, Allocator>::insert(
+    iterator pos, InputIt first, InputIt last) {
+  const size_type index = pos - begin();
+  const size_type old_size = size();
+  for (; first != last; ++first) {
+    push_back(*first);
+  }
+  // rotate the appended range into place - a single pass, no matter how
+  // many elements were inserted
+  reverse(index, old_size);
+  reverse(old_size, size());
+  reverse(index, size());
+  LAZY_VECTOR_CHECK_INVARIANTS();
+  return begin() + index;
+}
+
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::iterator lazy_vector<T, Allocator>::erase(iterator pos) {
+  return erase(pos, pos + 1);
+}
+
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::iterator lazy_vector<T, Allocator>::erase(
+    iterator first, iterator last) {
+  const size_type index = first - begin();
+  const size_type count = last - first;
+  if (count == 0) return first;
+
+  // shift the remainder down once, then drop the now unused end
+  const size_type n = size();
+  for (size_type i = index; i + count < n; ++i) {
+    (*this)[i] = std::move((*this)[i + count]);
+  }
+  erase_back(count, [](reference) {});
+  LAZY_VECTOR_CHECK_INVARIANTS();
+  return begin() + index;
+}
+
+template<class T, class Allocator>
+template<class Predicate>
+typename lazy_vector<T, Allocator>::size_type lazy_vector<T, Allocator>::erase_if(
+    Predicate pred) {
+  const size_type n = size();
+  size_type kept = 0;
+  for (size_type i = 0; i < n; ++i) {
+    reference element = (*this)[i];
+    if (pred(element)) continue;
+    if (kept != i) {
+      (*this)[kept] = std::move(element);
+    }
+    ++kept;
+  }
+  if (kept < n) {
+    erase_back(n - kept, [](reference) {});
+  }
+  LAZY_VECTOR_CHECK_INVARIANTS();
+  return n - kept;
+}
+
 template<class T, class Allocator>
 void lazy_vector<T, Allocator>::clear() {
   //deconstruct all existing elements in head & tail
@@ -381,6 +639,7 @@ void lazy_vector<T, Allocator>::clear() {
     tail.first[head.size + i].~value_type();
   }
   head.size = tail.size = 0;
+  LAZY_VECTOR_CHECK_INVARIANTS();
 }
 
 // the swap function is guaranteed to never throw
@@ -421,19 +680,171 @@ void lazy_vector<T, Allocator>::shorten() {
   head = { nullptr, 0, 0 };
 }
 
+//n must be > 0 and <= size()
 template<class T, class Allocator>
-void lazy_vector<T, Allocator>::empty_head() {
-  // clear out head and move to tail
-  for (size_type i = 0; i < head.size; ++i) {
-    new (tail.first + i)  value_type(*(head.first + i));
+template<class Consume>
+void lazy_vector<T, Allocator>::erase_back(const size_type n, Consume consume) {
+  const size_type new_size = size() - n;
+  const bool was_lazy = lazy();
+  if (was_lazy && 2 * n <= tail.size) {
+    // n calls to pop_back would each migrate one element back to head and
+    // remove one from the end of tail - do both as a batch
+    for (size_type i = new_size; i < new_size + n; ++i) {
+      consume(tail.first[i]);
+      tail.first[i].~value_type();
+    }
+    tail.size -= n;
+    migrate_back(n);
   }
-  for (size_type i = 0; i < head.size; ++i) {
+  else {
+    // remove [new_size, size()) - when a migration is in progress and the
+    // range reaches past the point where pop_back would have emptied tail,
+    // head ends up holding every remaining element
+    size_type pos = new_size;
+    for (; pos < head.size; ++pos) {
+      consume(head.first[pos]);
+      head.first[pos].~value_type();
+    }
+    for (; pos < head.size + tail.size; ++pos) {
+      consume(tail.first[pos]);
+      tail.first[pos].~value_type();
+    }
+    if (new_size > head.size) {
+      tail.size = new_size - head.size;
+      if (was_lazy) migrate_back(tail.size);
+    }
+    else {
+      head.size = new_size;
+      tail.size = 0;
+    }
+  }
+
+  // single shrink step for the whole batch
+  if (tail.size == 0 && head.capacity > 0) {
+    shorten();
+  }
+}
+
+// reverses the elements in [first, last)
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::reverse(size_type first, size_type last) {
+  using std::swap;
+
+  while (first + 1 < last) {
+    swap((*this)[first++], (*this)[--last]);
+  }
+}
+
+// moves the last n elements of head into tail, at the same positions
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::migrate(const size_type n) {
+  const size_type first = head.size - n;
+  // the next groups to migrate sit right below this one - fetch them into
+  // cache ahead of time, both the head source and the tail destination
+  const size_type ahead = LAZY_VECTOR_PREFETCH_DISTANCE * migration_group;
+  if (first >= ahead) {
+    LAZY_VECTOR_PREFETCH(head.first + first - ahead, 0);
+    LAZY_VECTOR_PREFETCH(tail.first + first - ahead, 1);
+  }
+  prefault_tail(head.size, first);
+  for (size_type i = first; i < head.size; ++i) {
+    new (tail.first + i) value_type(std::move(head.first[i]));
+    //explicitly destruct unused T in head
     head.first[i].~value_type();
   }
-  tail.size += head.size;
-  head.size = 0;
+  release_head(head.size, first);
+  head.size -= n;
+  tail.size += n;
+}
+
+// head and tail both index elements by their absolute position, so resolving
+// a position only selects the base pointer. The select is an integer multiply
+// rather than a branch, which random reads during a migration would
+// mispredict half of the time. (A mask built with neg/sbb is no better: sbb
+// keeps a false dependency on its register, chaining consecutive reads)
+template<class T, class Allocator>
+typename lazy_vector<T, Allocator>::pointer lazy_vector<T, Allocator>::address(
+    const size_type pos) const {
+  const std::uintptr_t tail_base = reinterpret_cast<std::uintptr_t>(tail.first);
+  const std::uintptr_t to_head = reinterpret_cast<std::uintptr_t>(head.first) - tail_base;
+  const std::uintptr_t in_head = pos < head.size;
+  return reinterpret_cast<pointer>(tail_base + in_head * to_head) + pos;
+}
+
+// called as the migration frontier moves down from old_first to new_first
+// when the allocator provides a prefault hook: each time the frontier enters
+// a new chunk, populate the chunk below it and the chunk above the
+// push_back frontier - both are still free storage in tail
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::prefault_tail(const size_type old_first,
+                                              const size_type new_first) {
+  typedef lazy_vector_prefault_traits<Allocator> traits;
+  if (traits::stride == 0) return;
+
+  const size_type chunk = traits::stride > sizeof(T) ? traits::stride / sizeof(T) : 1;
+  if (old_first / chunk == new_first / chunk) return;
+
+  const size_type below = new_first / chunk;
+  if (below > 0) {
+    traits::prefault(allocator, tail.first + (below - 1) * chunk, chunk * sizeof(T));
+  }
+  const size_type above = (head.size + tail.size) / chunk + 1;
+  if ((above + 1) * chunk <= tail.capacity) {
+    traits::prefault(allocator, tail.first + above * chunk, chunk * sizeof(T));
+  }
 }
 
+// called as the migration frontier moves down from old_first to new_first
+// when the allocator provides a release hook: every chunk of head that lies
+// wholly at or above the frontier, and did not before, holds no elements any
+// more. migrate_back may still construct into a released chunk, which then
+// faults in fresh pages
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::release_head(const size_type old_first,
+                                             const size_type new_first) {
+  typedef lazy_vector_prefault_traits<Allocator> traits;
+  if (traits::stride == 0) return;
+
+  const size_type chunk = traits::stride > sizeof(T) ? traits::stride / sizeof(T) : 1;
+  const size_type begin = (new_first + chunk - 1) / chunk;
+  const size_type end = (old_first + chunk - 1) / chunk;
+  for (size_type k = begin; k < end; ++k) {
+    const size_type last = (k + 1) * chunk < head.capacity ? (k + 1) * chunk : head.capacity;
+    lazy_vector_release_traits<Allocator>::release(allocator, head.first + k * chunk,
+                                                   (last - k * chunk) * sizeof(T));
+  }
+}
+
+// moves the first n elements of tail back into head, at the same positions
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::migrate_back(const size_type n) {
+  for (size_type i = head.size; i < head.size + n; ++i) {
+    new (head.first + i) value_type(std::move(tail.first[i]));
+    tail.first[i].~value_type();
+  }
+  head.size += n;
+  tail.size -= n;
+}
+
+#ifdef LAZY_VECTOR_CHECKED
+template<class T, class Allocator>
+void lazy_vector<T, Allocator>::check_invariants() const {
+  // tail indexes every element by its absolute position
+  LAZY_VECTOR_CHECK(head.size + tail.size <= tail.capacity);
+  LAZY_VECTOR_CHECK(tail.capacity == 0 || tail.first != nullptr);
+  // head is either unused or an older buffer of half the capacity
+  LAZY_VECTOR_CHECK(head.size <= head.capacity);
+  LAZY_VECTOR_CHECK(head.capacity == 0 || head.first != nullptr);
+  LAZY_VECTOR_CHECK(head.capacity == 0 || 2 * head.capacity == tail.capacity);
+  if (head.size > 0) {
+    // head must be empty before tail fills up, and tail is never left empty
+    // while head still holds elements
+    LAZY_VECTOR_CHECK(2 * head.size + tail.size <= tail.capacity);
+    LAZY_VECTOR_CHECK(tail.size > 0);
+  }
+}
+#endif
+
 template<class T, class Allocator>
 bool lazy_vector<T, Allocator>::lazy() const {
   if (head.capacity == 0) return 0; //head is unused
@@ -444,6 +855,10 @@ bool lazy_vector<T, Allocator>::lazy() const {
 template<class T, class Allocator>
 const typename lazy_vector<T, Allocator>::size_type lazy_vector<T, Allocator>::default_capacity = 1 << 4;
 
+template<class T, class Allocator>
+const typename lazy_vector<T, Allocator>::size_type lazy_vector<T, Allocator>::migration_group =
+    LAZY_VECTOR_MIGRATION_BYTES > sizeof(T) ? LAZY_VECTOR_MIGRATION_BYTES / sizeof(T) : 1;
+
 template<class T, class Allocator>
 Allocator lazy_vector<T, Allocator>::allocator;
 
@@ -552,7 +967,7 @@ typename lazy_vector<T, Allocator>::size_type lazy_vector<T, Allocator>::iterato
     else {
       //last iterator (*this) is in tail - calculate offset
       size_type tail_offset = current_ptr - tail_first; //distance or length between
-      size_type head_offset = head_last - it.current_ptr;
+      size_type head_offset = head_last - it.current_ptr + 1;
       return tail_offset + head_offset;
     }
   }
@@ -0,0 +1,240 @@
+
+// Replays workload traces (see workload_trace.h) against lazy_vector and
+// std::vector and reports throughput, latency percentiles per operation,
+// peak RSS and allocation counts for each. Each container is replayed in
+// its own child process, so peak RSS is per process and per container.
+//
+// Build with optimizations, e.g.
+//   g++ -std=c++11 -O2 trace_replay.cpp -o trace_replay
+//
+// Usage:
+//   trace_replay generate <workload> <ops> <file> [seed]
+//   trace_replay replay <file>
+//   trace_replay run <workload> <ops> [seed]
+// where <workload> is one of queue, growth, sawtooth, read_heavy, resize
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define TRACE_REPLAY_FORK 1
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "lazy_vector.h"
+#include "tracking_allocator.h"
+#include "workload_trace.h"
+
+typedef std::chrono::steady_clock replay_clock;
+
+static const char* const op_names[] = {
+  "push_back", "pop_back", "resize", "reserve", "clear", "read"
+};
+static const std::size_t op_count = sizeof(op_names) / sizeof(op_names[0]);
+
+// Returns freed heap pages to the OS and resets the peak resident set size
+// where the OS allows it
+static void reset_peak_rss() {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+#ifdef __linux__
+  std::FILE* clear_refs = std::fopen("/proc/self/clear_refs", "w");
+  if (clear_refs) {
+    std::fputs("5", clear_refs);
+    std::fclose(clear_refs);
+  }
+#endif
+}
+
+// Returns the peak resident set size in KiB, or -1 if unknown
+static long peak_rss_kib() {
+#ifdef __linux__
+  std::FILE* status = std::fopen("/proc/self/status", "r");
+  if (status) {
+    char line[256];
+    long kib = -1;
+    while (std::fgets(line, sizeof(line), status)) {
+      if (std::sscanf(line, "VmHWM: %ld kB", &kib) == 1) break;
+    }
+    std::fclose(status);
+    if (kib >= 0) return kib;
+  }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+static double percentile(std::vector<double>& samples, double p) {
+  if (samples.empty()) return 0.0;
+  std::size_t idx = static_cast<std::size_t>(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+  return samples[idx];
+}
+
+template<class Vector>
+static void replay(const char* name, const std::vector<trace_record>& records) {
+  typedef tracking_allocator<int> alloc_type;
+
+  // latency samples are allocated and touched up front, so they count
+  // neither towards the replayed vector's allocations nor its peak RSS
+  std::vector<double> latencies(records.size(), 0.0);
+  alloc_type::reset();
+  reset_peak_rss();
+  const long rss_before = peak_rss_kib();
+
+  long long checksum = 0;
+  replay_clock::time_point start = replay_clock::now();
+  {
+    Vector vec;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      const trace_record& record = records[i];
+      replay_clock::time_point op_start = replay_clock::now();
+      switch (record.op) {
+        case trace_op::push_back:
+          vec.push_back(static_cast<int>(i));
+          break;
+        case trace_op::pop_back:
+          if (!vec.empty()) vec.pop_back();
+          break;
+        case trace_op::resize:
+          vec.resize(static_cast<std::size_t>(record.arg));
+          break;
+        case trace_op::reserve:
+          vec.reserve(static_cast<std::size_t>(record.arg));
+          break;
+        case trace_op::clear:
+          vec.clear();
+          break;
+        case trace_op::read:
+          if (!vec.empty()) checksum += vec[record.arg % vec.size()];
+          break;
+      }
+      latencies[i] = std::chrono::duration<double, std::nano>(
+          replay_clock::now() - op_start).count();
+    }
+  }
+  const double total_ns = std::chrono::duration<double, std::nano>(
+      replay_clock::now() - start).count();
+  const long rss_after = peak_rss_kib();
+  const tracking_allocator_stats stats = alloc_type::stats();
+
+  std::printf("%s\n", name);
+  std::printf("  %.2f Mops/s, %zu allocations, peak %.1f MiB allocated",
+              records.size() / (total_ns / 1e3), stats.allocations,
+              stats.peak_bytes / (1024.0 * 1024.0));
+  if (rss_after >= 0) {
+    std::printf(", process peak RSS %.1f MiB (+%.1f MiB)", rss_after / 1024.0,
+                (rss_after - rss_before) / 1024.0);
+  }
+  std::printf("   (checksum %lld)\n", checksum);
+
+  std::printf("  %-10s %12s %10s %10s %10s %12s\n",
+              "op", "count", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+  std::vector<double> samples;
+  for (std::size_t op = 0; op < op_count; ++op) {
+    samples.clear();
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      if (static_cast<std::size_t>(records[i].op) == op) samples.push_back(latencies[i]);
+    }
+    if (samples.empty()) continue;
+    const double p50 = percentile(samples, 0.5);
+    const double p99 = percentile(samples, 0.99);
+    const double p999 = percentile(samples, 0.999);
+    const double max = percentile(samples, 1.0);
+    std::printf("  %-10s %12zu %10.0f %10.0f %10.0f %12.0f\n",
+                op_names[op], samples.size(), p50, p99, p999, max);
+  }
+  std::printf("\n");
+}
+
+// Replays in a child process where fork is available, so peak RSS is not
+// skewed by heap pages an earlier replay left resident
+template<class Vector>
+static void replay_isolated(const char* name, const std::vector<trace_record>& records) {
+  std::fflush(stdout);
+#ifdef TRACE_REPLAY_FORK
+  const pid_t child = fork();
+  if (child == 0) {
+    replay<Vector>(name, records);
+    std::fflush(stdout);
+    _exit(0);
+  }
+  if (child > 0) {
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      throw std::runtime_error(std::string("replay of ") + name + " failed");
+    return;
+  }
+#endif
+  replay<Vector>(name, records);
+}
+
+static void replay_all(const std::vector<trace_record>& records) {
+  std::printf("%zu operations\n\n", records.size());
+  replay_isolated<std::vector<int, tracking_allocator<int>>>("std::vector", records);
+  replay_isolated<lazy_vector<int, tracking_allocator<int>>>("lazy_vector", records);
+}
+
+static int usage() {
+  std::fprintf(stderr,
+               "usage: trace_replay generate <workload> <ops> <file> [seed]\n"
+               "       trace_replay replay <file>\n"
+               "       trace_replay run <workload> <ops> [seed]\n"
+               "workloads: queue, growth, sawtooth, read_heavy, resize\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) return usage();
+  const std::string command = argv[1];
+
+  try {
+    if (command == "generate" && (argc == 5 || argc == 6)) {
+      const unsigned int seed = argc == 6 ? std::strtoul(argv[5], nullptr, 10) : 1;
+      std::vector<trace_record> records = generate_trace(
+          parse_trace_workload(argv[2]), std::strtoull(argv[3], nullptr, 10), seed);
+      std::ofstream out(argv[4], std::ios::binary);
+      write_trace(out, records);
+    }
+    else if (command == "replay" && argc == 3) {
+      std::ifstream in(argv[2], std::ios::binary);
+      if (!in) throw std::runtime_error(std::string("cannot open ") + argv[2]);
+      replay_all(read_trace(in));
+    }
+    else if (command == "run" && (argc == 4 || argc == 5)) {
+      const unsigned int seed = argc == 5 ? std::strtoul(argv[4], nullptr, 10) : 1;
+      replay_all(generate_trace(parse_trace_workload(argv[2]),
+                                std::strtoull(argv[3], nullptr, 10), seed));
+    }
+    else {
+      return usage();
+    }
+  }
+  catch (const std::exception& e) {
+    std::fprintf(stderr, "trace_replay: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+
+#ifndef TRACKING_ALLOCATOR_H_
+#define TRACKING_ALLOCATOR_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Counters kept by tracking_allocator, shared by all of its instantiations
+struct tracking_allocator_stats {
+  std::size_t allocations;      // calls to allocate
+  std::size_t deallocations;    // calls to deallocate that matched a live buffer
+  std::size_t live_buffers;     // buffers allocated and not yet released
+  std::size_t live_bytes;       // bytes in those buffers
+  std::size_t peak_bytes;       // highest live_bytes seen
+  std::size_t double_frees;     // deallocate of a buffer that is not live
+  std::size_t size_mismatches;  // deallocate with a different size than allocated
+};
+
+// An allocator for validating lazy_vector and friends under load. It records
+// every live buffer, so leaked buffers, double frees and deallocations with a
+// wrong size show up in stats() and report(), along with the peak amount of
+// bytes in use. Bad deallocations are counted and not passed on, so a run can
+// continue and report all of them.
+//
+// The bookkeeping takes a lock and a hash map lookup per call - it is meant
+// for checked builds and load replays, not for production.
+template<class T>
+class tracking_allocator {
+public:
+  typedef T           value_type;
+  typedef T*          pointer;
+  typedef std::size_t size_type;
+
+  template<class U>
+  struct rebind {
+    typedef tracking_allocator<U> other;
+  };
+
+  tracking_allocator() {}
+  template<class U>
+  tracking_allocator(const tracking_allocator<U>&) {}
+
+  // Allocates storage for n objects T - may throw std::bad_alloc
+  pointer allocate(const size_type n);
+  // Releases storage previously returned by allocate(n)
+  void deallocate(pointer p, const size_type n);
+
+  // Returns a snapshot of the counters
+  static tracking_allocator_stats stats();
+  // Prints the counters and every leaked buffer to out
+  // Returns 1 if no problems were found, else 0
+  static bool report(std::FILE* out = stderr);
+  // Forgets all live buffers and zeroes the counters
+  static void reset();
+};
+
+template<class T, class U>
+bool operator==(const tracking_allocator<T>&, const tracking_allocator<U>&) {
+  return true;
+}
+
+template<class T, class U>
+bool operator!=(const tracking_allocator<T>&, const tracking_allocator<U>&) {
+  return false;
+}
+
+/*----------------------------------------*
+ | BEGIN TRACKING_ALLOCATOR IMPLEMENTATION
+ *----------------------------------------*/
+
+namespace tracking_allocator_detail {
+
+struct registry {
+  std::mutex lock;
+  std::unordered_map<const void*, std::size_t> live; // buffer -> bytes
+  tracking_allocator_stats stats;
+};
+
+inline registry& get_registry() {
+  // intentionally leaked, so that it outlives static objects that still
+  // release buffers during shutdown
+  static registry* instance = new registry();
+  return *instance;
+}
+
+} // namespace tracking_allocator_detail
+
+template<class T>
+typename tracking_allocator<T>::pointer tracking_allocator<T>::allocate(const size_type n) {
+  pointer p = std::allocator<T>().allocate(n);
+  const std::size_t bytes = n * sizeof(T);
+
+  tracking_allocator_detail::registry& reg = tracking_allocator_detail::get_registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  reg.live[p] = bytes;
+  ++reg.stats.allocations;
+  ++reg.stats.live_buffers;
+  reg.stats.live_bytes += bytes;
+  if (reg.stats.live_bytes > reg.stats.peak_bytes) {
+    reg.stats.peak_bytes = reg.stats.live_bytes;
+  }
+  return p;
+}
+
+template<class T>
+void tracking_allocator<T>::deallocate(pointer p, const size_type n) {
+  if (p == nullptr && n == 0) return;
+  const std::size_t bytes = n * sizeof(T);
+  {
+    tracking_allocator_detail::registry& reg = tracking_allocator_detail::get_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    auto it = reg.live.find(p);
+    if (it == reg.live.end()) {
+      // not live - freeing it again would corrupt the heap
+      ++reg.stats.double_frees;
+      return;
+    }
+    if (it->second != bytes) {
+      ++reg.stats.size_mismatches;
+    }
+    reg.stats.live_bytes -= it->second;
+    --reg.stats.live_buffers;
+    ++reg.stats.deallocations;
+    reg.live.erase(it);
+  }
+  std::allocator<T>().deallocate(p, n);
+}
+
+template<class T>
+tracking_allocator_stats tracking_allocator<T>::stats() {
+  tracking_allocator_detail::registry& reg = tracking_allocator_detail::get_registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  return reg.stats;
+}
+
+template<class T>
+bool tracking_allocator<T>::report(std::FILE* out) {
+  tracking_allocator_detail::registry& reg = tracking_allocator_detail::get_registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  const tracking_allocator_stats& s = reg.stats;
+
+  std::fprintf(out, "tracking_allocator: %zu allocations, %zu deallocations, peak %zu bytes\n",
+               s.allocations, s.deallocations, s.peak_bytes);
+  std::fprintf(out, "tracking_allocator: %zu leaked buffers (%zu bytes), "
+                    "%zu double frees, %zu size mismatches\n",
+               s.live_buffers, s.live_bytes, s.double_frees, s.size_mismatches);
+  for (const auto& buffer : reg.live) {
+    std::fprintf(out, "  leaked %zu bytes at %p\n", buffer.second, buffer.first);
+  }
+  return s.live_buffers == 0 && s.double_frees == 0 && s.size_mismatches == 0;
+}
+
+template<class T>
+void tracking_allocator<T>::reset() {
+  tracking_allocator_detail::registry& reg = tracking_allocator_detail::get_registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  reg.live.clear();
+  reg.stats = tracking_allocator_stats();
+}
+
+/*-----------------------------------------
+ | END TRACKING_ALLOCATOR IMPLEMENTATION
+ *----------------------------------------*/
+
+#endif // TRACKING_ALLOCATOR_H_
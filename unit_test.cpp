@@ -1,5 +1,18 @@
 
+// run the whole suite with the head/tail invariants checked after every
+// mutating operation
+#define LAZY_VECTOR_CHECKED
+
 #include "lazy_vector.h"
+#include "lazy_priority_queue.h"
+#include "lazy_ring_queue.h"
+#include "huge_page_allocator.h"
+#include "tracking_allocator.h"
+#include "workload_trace.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
 
 // The type to be tested on lazy_vector
 // TestType allocates memory to test if lazy_vector calls its destructors properly
@@ -17,7 +30,9 @@ public:
   }
 
   TestType& operator=(const TestType& t) {
+    int* old_x = x;
     x = (t.x == nullptr) ? nullptr : new int(*t.x); 
+    delete old_x;
     return *this;
   }
   int* x;
@@ -227,6 +242,31 @@ BOOST_AUTO_TEST_CASE(rnd_access_operator) {
   BOOST_CHECK_EQUAL(third_value, vec[2]);
 }
 
+BOOST_AUTO_TEST_CASE(at_out_of_range) {
+  lazy_vector<int> vec = { 1, 11, 19 };
+  BOOST_CHECK_THROW(vec.at(3), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(const_access) {
+  lazy_vector<int> vec;
+  // stop part way through a migration so positions resolve to both regions
+  for (int i = 0; i < 40; ++i) {
+    vec.push_back(i);
+  }
+  const lazy_vector<int>& const_vec = vec;
+  for (int i = 0; i < 40; ++i) {
+    BOOST_CHECK_EQUAL(const_vec[i], i);
+    BOOST_CHECK_EQUAL(const_vec.at(i), i);
+  }
+  BOOST_CHECK_EQUAL(const_vec.front(), 0);
+  BOOST_CHECK_EQUAL(const_vec.back(), 39);
+
+  vec.front() = -1;
+  vec.back() = -2;
+  BOOST_CHECK_EQUAL(const_vec[0], -1);
+  BOOST_CHECK_EQUAL(const_vec[39], -2);
+}
+
 BOOST_AUTO_TEST_CASE(front_element) {
   int first_value = 1;
   lazy_vector<int> vec = { first_value, 11, 19, 25, 43 };
@@ -239,6 +279,360 @@ BOOST_AUTO_TEST_CASE(back_element) {
   BOOST_CHECK_EQUAL(last_value, vec.back());
 }
 
+BOOST_AUTO_TEST_CASE(push_back_self_reference) {
+  // push a copy of each element, including the ones the push migrates
+  for (int n = 1; n < 80; ++n) {
+    for (int i = 0; i < n; ++i) {
+      lazy_vector<std::string> vec;
+      for (int j = 0; j < n; ++j) {
+        vec.push_back("element number " + std::to_string(j));
+      }
+      vec.push_back(vec[i]);
+      BOOST_REQUIRE_EQUAL(vec.back(), "element number " + std::to_string(i));
+      BOOST_REQUIRE_EQUAL(vec[i], vec.back());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(take_back) {
+  lazy_vector<TestType> vec;
+  for (int i = 0; i < 100; ++i) {
+    TestType t;
+    *t.x = i;
+    vec.push_back(t);
+  }
+  TestType last = vec.take_back();
+  BOOST_CHECK_EQUAL(*last.x, 99);
+
+  TestType second_last;
+  vec.pop_back_into(second_last);
+  BOOST_CHECK_EQUAL(*second_last.x, 98);
+  BOOST_CHECK_EQUAL(vec.size(), 98);
+  BOOST_CHECK_EQUAL(*vec.back().x, 97);
+}
+
+BOOST_AUTO_TEST_CASE(drain) {
+  // drain from every point of a migration and compare against pop_back
+  for (int n = 1; n < 150; n += 7) {
+    for (int drained = 0; drained <= n + 3; drained += 3) {
+      lazy_vector<int> vec;
+      for (int i = 0; i < n; ++i) {
+        vec.push_back(i);
+      }
+      std::vector<int> out;
+      size_t moved = vec.drain(drained, std::back_inserter(out));
+      size_t expected = std::min(drained, n);
+
+      BOOST_CHECK_EQUAL(moved, expected);
+      BOOST_CHECK_EQUAL(vec.size(), n - expected);
+      for (size_t i = 0; i < out.size(); ++i) {
+        BOOST_CHECK_EQUAL(out[i], static_cast<int>(n - expected + i));
+      }
+      for (size_t i = 0; i < vec.size(); ++i) {
+        BOOST_CHECK_EQUAL(vec[i], static_cast<int>(i));
+      }
+      // the container must stay usable afterwards
+      for (int i = 0; i < 50; ++i) {
+        vec.push_back(i);
+      }
+      BOOST_CHECK_EQUAL(vec.back(), 49);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(drain_destructor_calls) {
+  lazy_vector<TestType> vec;
+  for (int i = 0; i < 3000; ++i) {
+    vec.push_back(TestType());
+  }
+  std::vector<TestType> out;
+  vec.drain(1200, std::back_inserter(out));
+  vec.drain(10, std::back_inserter(out));
+  vec.drain(5000, std::back_inserter(out));
+  BOOST_CHECK(vec.empty());
+  BOOST_CHECK_EQUAL(out.size(), 3000);
+}
+
+BOOST_AUTO_TEST_CASE(iterator_distance) {
+  lazy_vector<int> vec;
+  // 20 elements leaves a migration from head to tail half done
+  for (int i = 0; i < 20; ++i) {
+    vec.push_back(i);
+  }
+  BOOST_CHECK_EQUAL(vec.end() - vec.begin(), vec.size());
+  BOOST_CHECK_EQUAL(*(vec.begin() + 15), 15);
+}
+
+BOOST_AUTO_TEST_CASE(insert) {
+  for (int n = 0; n < 70; n += 3) {
+    lazy_vector<int> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < n; ++i) {
+      vec.push_back(i);
+      expected.push_back(i);
+    }
+    int pos = n / 3;
+    BOOST_CHECK_EQUAL(*vec.insert(vec.begin() + pos, -1), -1);
+    expected.insert(expected.begin() + pos, -1);
+
+    std::vector<int> range = { 100, 101, 102, 103, 104, 105, 106 };
+    BOOST_CHECK_EQUAL(*vec.insert(vec.begin() + pos + 1, range.begin(), range.end()), 100);
+    expected.insert(expected.begin() + pos + 1, range.begin(), range.end());
+
+    BOOST_CHECK_EQUAL(vec.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      BOOST_CHECK_EQUAL(vec[i], expected[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(insert_self_reference) {
+  // insert a copy of each element, including ones about to migrate, at the
+  // front, middle and back
+  for (int n = 1; n < 40; ++n) {
+    for (int i = 0; i < n; ++i) {
+      const int positions[] = { 0, n / 2, n };
+      for (const int pos : positions) {
+        lazy_vector<std::string> vec;
+        std::vector<std::string> expected;
+        for (int j = 0; j < n; ++j) {
+          vec.push_back("element number " + std::to_string(j));
+          expected.push_back(vec.back());
+        }
+        vec.insert(vec.begin() + pos, vec[i]);
+        expected.insert(expected.begin() + pos, expected[i]);
+
+        BOOST_REQUIRE_EQUAL(vec.size(), expected.size());
+        bool matches = true;
+        for (size_t j = 0; j < expected.size(); ++j) {
+          matches = matches && vec[j] == expected[j];
+        }
+        BOOST_REQUIRE(matches);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(erase) {
+  for (int n = 1; n < 70; n += 3) {
+    lazy_vector<int> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < n; ++i) {
+      vec.push_back(i);
+      expected.push_back(i);
+    }
+    int pos = n / 2;
+    lazy_vector<int>::iterator next = vec.erase(vec.begin() + pos);
+    expected.erase(expected.begin() + pos);
+    if (pos < n - 1) BOOST_CHECK_EQUAL(*next, pos + 1);
+
+    int count = std::min(5, static_cast<int>(expected.size()) - pos / 2);
+    vec.erase(vec.begin() + pos / 2, vec.begin() + pos / 2 + count);
+    expected.erase(expected.begin() + pos / 2, expected.begin() + pos / 2 + count);
+
+    BOOST_CHECK_EQUAL(vec.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      BOOST_CHECK_EQUAL(vec[i], expected[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(erase_range_mid_migration) {
+  // large ranges removed at every point of a migration take the batched
+  // path through both head and tail
+  for (int n = 17; n < 300; n += 23) {
+    for (int count = 1; count <= n; count += 11) {
+      lazy_vector<TestType> vec;
+      for (int i = 0; i < n; ++i) {
+        TestType t;
+        *t.x = i;
+        vec.push_back(t);
+      }
+      const int first = (n - count) / 3;
+      vec.erase(vec.begin() + first, vec.begin() + first + count);
+
+      BOOST_REQUIRE_EQUAL(vec.size(), static_cast<size_t>(n - count));
+      bool matches = true;
+      for (int i = 0; i < n - count; ++i) {
+        matches = matches && *vec[i].x == (i < first ? i : i + count);
+      }
+      BOOST_CHECK(matches);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(erase_if) {
+  lazy_vector<TestType> vec;
+  for (int i = 0; i < 1000; ++i) {
+    TestType t;
+    *t.x = i;
+    vec.push_back(t);
+  }
+  size_t removed = vec.erase_if([](const TestType& t) { return *t.x % 3 != 0; });
+
+  BOOST_CHECK_EQUAL(removed, 666);
+  BOOST_CHECK_EQUAL(vec.size(), 334);
+  for (size_t i = 0; i < vec.size(); ++i) {
+    BOOST_CHECK_EQUAL(*vec[i].x, static_cast<int>(3 * i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(mixed_operations) {
+  // push, pop and drain in uneven steps so migrations are interrupted in
+  // every state, then compare against std::vector
+  lazy_vector<int> vec;
+  std::vector<int> expected;
+  unsigned int seed = 7;
+  for (int step = 0; step < 3000; ++step) {
+    seed = seed * 1103515245 + 12345;
+    unsigned int op = (seed >> 16) % 8;
+    if (op < 6) {
+      vec.push_back(step);
+      expected.push_back(step);
+    }
+    else if (op == 6 && !expected.empty()) {
+      vec.pop_back();
+      expected.pop_back();
+    }
+    else if (op == 7) {
+      size_t n = (seed >> 8) % 8;
+      std::vector<int> out;
+      vec.drain(n, std::back_inserter(out));
+      expected.resize(expected.size() - out.size());
+    }
+    BOOST_REQUIRE_EQUAL(vec.size(), expected.size());
+  }
+  BOOST_CHECK(expected.size() > 100);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_EQUAL(vec[i], expected[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(huge_page_allocator_large_buffers) {
+  // 2^21 ints = 8 MiB, well past the mmap threshold, so this runs through
+  // migrations between mapped buffers with the prefault hook active
+  const int n = 1 << 21;
+  lazy_vector<int, huge_page_allocator<int>> vec;
+  for (int i = 0; i < n; ++i) {
+    vec.push_back(i);
+  }
+  std::vector<int> out;
+  vec.drain(n / 2, std::back_inserter(out));
+  for (int i = 0; i < n / 2 + 5; ++i) {
+    vec.push_back(i);
+  }
+
+  BOOST_CHECK_EQUAL(vec.size(), static_cast<size_t>(n + 5));
+  bool in_order = true;
+  for (int i = 0; i < n / 2; ++i) {
+    in_order = in_order && vec[i] == i && out[i] == n / 2 + i;
+  }
+  BOOST_CHECK(in_order);
+}
+
+BOOST_AUTO_TEST_CASE(huge_page_allocator_release) {
+  // stop half way through migrating an 8 MiB head, so the released chunks
+  // above the frontier get written again by pop_back's migrate_back
+  const int n = (1 << 21) + (1 << 20);
+  lazy_vector<int, huge_page_allocator<int>> vec;
+  for (int i = 0; i < n; ++i) {
+    vec.push_back(i);
+  }
+  for (int i = 0; i < (1 << 20); ++i) {
+    vec.pop_back();
+  }
+  for (int i = 0; i < (1 << 19); ++i) {
+    vec.push_back(-i);
+  }
+
+  BOOST_REQUIRE_EQUAL(vec.size(), static_cast<size_t>((1 << 21) + (1 << 19)));
+  bool in_order = true;
+  for (int i = 0; i < (1 << 21); ++i) {
+    in_order = in_order && vec[i] == i;
+  }
+  for (int i = 0; i < (1 << 19); ++i) {
+    in_order = in_order && vec[(1 << 21) + i] == -i;
+  }
+  BOOST_CHECK(in_order);
+}
+
+BOOST_AUTO_TEST_CASE(tracking_allocator_detects) {
+  typedef tracking_allocator<int> alloc_type;
+  alloc_type::reset();
+  alloc_type alloc;
+
+  int* kept = alloc.allocate(8);
+  int* freed = alloc.allocate(4);
+  alloc.deallocate(freed, 4);
+  alloc.deallocate(freed, 4);
+
+  tracking_allocator_stats stats = alloc_type::stats();
+  BOOST_CHECK_EQUAL(stats.live_buffers, 1);
+  BOOST_CHECK_EQUAL(stats.live_bytes, 8 * sizeof(int));
+  BOOST_CHECK_EQUAL(stats.peak_bytes, 12 * sizeof(int));
+  BOOST_CHECK_EQUAL(stats.double_frees, 1);
+
+  alloc.deallocate(kept, 8);
+  alloc_type::reset();
+}
+
+BOOST_AUTO_TEST_CASE(tracking_allocator_no_leaks) {
+  typedef tracking_allocator<TestType> alloc_type;
+  typedef lazy_vector<TestType, alloc_type> vector_type;
+  alloc_type::reset();
+  {
+    vector_type vec;
+    for (int i = 0; i < 1000; ++i) {
+      vec.push_back(TestType());
+    }
+    // copies of an empty vector, of one in the middle of a migration and of
+    // one whose migration just finished must not share buffers
+    vector_type empty_vec;
+    vector_type empty_copy(empty_vec);
+    vector_type migrating_copy(vec);
+    for (int i = 0; i < 24; ++i) {
+      vec.push_back(TestType());
+    }
+    vector_type migrated_copy(vec);
+
+    vec.reserve(100);
+    vec.reserve(5000);
+    std::vector<TestType> out;
+    vec.drain(700, std::back_inserter(out));
+    vec.erase(vec.begin() + 10, vec.begin() + 20);
+    vec.resize(3000);
+    migrating_copy = migrated_copy;
+    BOOST_CHECK_EQUAL(migrated_copy.size(), 1024);
+  }
+  tracking_allocator_stats stats = alloc_type::stats();
+  BOOST_CHECK(stats.peak_bytes > 0);
+  BOOST_CHECK_EQUAL(stats.live_buffers, 0);
+  BOOST_CHECK_EQUAL(stats.double_frees, 0);
+  BOOST_CHECK_EQUAL(stats.size_mismatches, 0);
+}
+
+BOOST_AUTO_TEST_CASE(reserve_keeps_elements) {
+  lazy_vector<int> vec;
+  for (int i = 0; i < 20; ++i) {
+    vec.push_back(i);
+  }
+  // a smaller reservation must leave the vector untouched
+  size_t old_capacity = vec.capacity();
+  vec.reserve(10);
+  BOOST_CHECK_EQUAL(vec.capacity(), old_capacity);
+
+  vec.reserve(1000);
+  BOOST_CHECK(vec.capacity() >= 1000);
+  BOOST_CHECK_EQUAL(vec.size(), 20);
+  for (int i = 0; i < 20; ++i) {
+    BOOST_CHECK_EQUAL(vec[i], i);
+  }
+  for (int i = 0; i < 20; ++i) {
+    vec.pop_back();
+  }
+  BOOST_CHECK(vec.empty());
+}
+
 BOOST_AUTO_TEST_CASE(swap) {
   int original_vec1_val = 1;
   int original_vec2_val = 2;
@@ -261,3 +655,210 @@ BOOST_AUTO_TEST_CASE(clear) {
   BOOST_CHECK_EQUAL(vec.size(), 0);
 }
 
+
+BOOST_AUTO_TEST_CASE(push_after_emptied) {
+  lazy_vector<int> vec = { 1 };
+  vec.pop_back();
+  for (int i = 0; i < 40; ++i) {
+    vec.push_back(i);
+  }
+  BOOST_CHECK_EQUAL(vec.size(), 40);
+  BOOST_CHECK_EQUAL(vec[39], 39);
+}
+
+BOOST_AUTO_TEST_CASE(priority_queue_push_pop) {
+  lazy_priority_queue<int> queue;
+  // enough elements to run through several migrations of the storage
+  for (int i = 0; i < 5000; ++i) {
+    queue.push((i * 7919) % 5000);
+  }
+  BOOST_CHECK_EQUAL(queue.size(), 5000);
+
+  for (int expected = 4999; expected >= 0; --expected) {
+    BOOST_CHECK_EQUAL(queue.top(), expected);
+    queue.pop();
+  }
+  BOOST_CHECK(queue.empty());
+
+  // queue must be reusable after being emptied
+  queue.push(3);
+  queue.push(8);
+  BOOST_CHECK_EQUAL(queue.top(), 8);
+}
+
+BOOST_AUTO_TEST_CASE(priority_queue_heapify_d_ary) {
+  std::vector<int> input;
+  for (int i = 0; i < 1000; ++i) {
+    input.push_back((i * 31) % 1000);
+  }
+  lazy_priority_queue<int, std::greater<int>, 4> queue(input.begin(), input.end());
+  queue.heapify(input.begin(), input.begin() + 10);
+  BOOST_CHECK_EQUAL(queue.size(), 1010);
+
+  int previous = queue.top();
+  while (!queue.empty()) {
+    BOOST_CHECK(previous <= queue.top());
+    previous = queue.top();
+    queue.pop();
+  }
+  BOOST_CHECK_EQUAL(previous, 999);
+}
+
+BOOST_AUTO_TEST_CASE(ring_queue_fifo_order) {
+  lazy_ring_queue<int> queue;
+  int next_push = 0, next_pop = 0;
+  // interleave pushes and pops so the ring wraps around while it migrates
+  for (int round = 0; round < 200; ++round) {
+    for (int i = 0; i < 37; ++i) {
+      queue.push_back(next_push++);
+    }
+    for (int i = 0; i < 23; ++i) {
+      BOOST_CHECK_EQUAL(queue.front(), next_pop++);
+      queue.pop_front();
+    }
+    BOOST_CHECK_EQUAL(queue.back(), next_push - 1);
+  }
+  BOOST_CHECK_EQUAL(queue.size(), static_cast<size_t>(next_push - next_pop));
+  BOOST_CHECK(queue.size() <= queue.capacity());
+}
+
+BOOST_AUTO_TEST_CASE(ring_queue_push_n_pop_n) {
+  lazy_ring_queue<TestType> queue;
+  std::vector<TestType> input(1000);
+  for (int i = 0; i < 1000; ++i) {
+    *input[i].x = i;
+  }
+  queue.push_n(input.begin(), 600);
+  std::vector<TestType> output;
+  BOOST_CHECK_EQUAL(queue.pop_n(std::back_inserter(output), 100), 100);
+  queue.push_n(input.begin() + 600, 400);
+  BOOST_CHECK_EQUAL(queue.pop_n(std::back_inserter(output), 5000), 900);
+
+  BOOST_CHECK(queue.empty());
+  for (int i = 0; i < 1000; ++i) {
+    BOOST_CHECK_EQUAL(*output[i].x, i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ring_queue_push_n_batches) {
+  // a single large batch grows the ring once
+  tracking_allocator<int>::reset();
+  {
+    lazy_ring_queue<int, tracking_allocator<int>> queue;
+    std::vector<int> input(1000);
+    for (int i = 0; i < 1000; ++i) input[i] = i;
+    queue.push_n(input.begin(), input.size());
+    BOOST_CHECK_EQUAL(tracking_allocator<int>::stats().allocations, 2);
+    BOOST_CHECK_EQUAL(queue.capacity(), 1024);
+    BOOST_CHECK_EQUAL(queue.front(), 0);
+    BOOST_CHECK_EQUAL(queue.back(), 999);
+  }
+  tracking_allocator_stats stats = tracking_allocator<int>::stats();
+  BOOST_CHECK_EQUAL(stats.live_buffers, 0);
+  BOOST_CHECK_EQUAL(stats.double_frees, 0);
+  BOOST_CHECK_EQUAL(stats.size_mismatches, 0);
+
+  // batches of varying size land mid-migration and across the ring wrap
+  lazy_ring_queue<int> queue;
+  int next_push = 0, next_pop = 0;
+  bool in_order = true;
+  int batch[61];
+  for (int round = 0; round < 300; ++round) {
+    const int batch_size = (round * 7) % 61;
+    for (int i = 0; i < batch_size; ++i) batch[i] = next_push++;
+    queue.push_n(batch, batch_size);
+    queue.push_back(next_push++);
+    for (int i = 0; i < 19 && !queue.empty(); ++i) {
+      in_order = in_order && queue.front() == next_pop++;
+      queue.pop_front();
+    }
+  }
+  while (!queue.empty()) {
+    in_order = in_order && queue.front() == next_pop++;
+    queue.pop_front();
+  }
+  BOOST_CHECK(in_order);
+  BOOST_CHECK_EQUAL(next_pop, next_push);
+}
+
+BOOST_AUTO_TEST_CASE(spsc_ring_queue_threads) {
+  const int n = 200000;
+  lazy_spsc_ring_queue<int> queue;
+
+  std::thread producer([&queue, n]() {
+    int batch[7];
+    int i = 0;
+    while (i < n) {
+      if (i % 3 == 0 && n - i >= 7) {
+        for (int j = 0; j < 7; ++j) batch[j] = i + j;
+        queue.push_n(batch, 7);
+        i += 7;
+      }
+      else {
+        queue.push_back(i++);
+      }
+    }
+  });
+
+  int expected = 0;
+  bool in_order = true;
+  int batch[5];
+  while (expected < n) {
+    size_t popped = queue.pop_n(batch, 5);
+    for (size_t j = 0; j < popped; ++j) {
+      in_order = in_order && batch[j] == expected++;
+    }
+    int val;
+    if (queue.try_pop_front(val)) {
+      in_order = in_order && val == expected++;
+    }
+  }
+  producer.join();
+
+  BOOST_CHECK(in_order);
+  BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(workload_trace_round_trip) {
+  std::vector<trace_record> records = generate_trace(trace_workload::resize, 5000, 3);
+  BOOST_CHECK_EQUAL(records.size(), 5000);
+
+  std::stringstream buffer;
+  write_trace(buffer, records);
+  std::vector<trace_record> decoded = read_trace(buffer);
+
+  BOOST_REQUIRE_EQUAL(decoded.size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    BOOST_CHECK(decoded[i].op == records[i].op);
+    BOOST_CHECK_EQUAL(decoded[i].arg, records[i].arg);
+  }
+
+  std::stringstream truncated(buffer.str().substr(0, buffer.str().size() / 2));
+  BOOST_CHECK_THROW(read_trace(truncated), std::runtime_error);
+
+  // a corrupt record count must not be trusted for the reservation
+  std::string corrupt = buffer.str();
+  for (size_t i = 8; i < 16; ++i) corrupt[i] = '\xff';
+  std::stringstream corrupt_count(corrupt);
+  BOOST_CHECK_THROW(read_trace(corrupt_count), std::runtime_error);
+  BOOST_CHECK_THROW(parse_trace_workload("bursty"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(workload_trace_generated_sizes) {
+  // generated traces never pop from an empty vector
+  const trace_workload workloads[] = { trace_workload::queue, trace_workload::growth,
+                                       trace_workload::sawtooth, trace_workload::read_heavy,
+                                       trace_workload::resize };
+  for (const auto workload : workloads) {
+    std::vector<trace_record> records = generate_trace(workload, 20000, 11);
+    unsigned long long size = 0;
+    bool valid = true;
+    for (const auto& record : records) {
+      if (record.op == trace_op::push_back) ++size;
+      else if (record.op == trace_op::pop_back) valid = valid && size-- > 0;
+      else if (record.op == trace_op::resize) size = record.arg;
+      else if (record.op == trace_op::clear) size = 0;
+    }
+    BOOST_CHECK(valid);
+  }
+}
@@ -0,0 +1,282 @@
+
+#ifndef WORKLOAD_TRACE_H_
+#define WORKLOAD_TRACE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Recorded or generated sequences of vector operations, replayed by
+// trace_replay.cpp against lazy_vector and std::vector.
+//
+// Binary format, all integers little endian:
+//   "LVTR"              4 byte magic
+//   version             uint32, currently 1
+//   record count        uint64
+//   records             1 byte opcode, then for opcodes with an argument
+//                       the argument as an unsigned LEB128 varint
+// push_back, pop_back and clear carry no argument, so a typical trace costs
+// one to three bytes per operation.
+
+enum class trace_op : unsigned char {
+  push_back = 0,
+  pop_back  = 1,
+  resize    = 2, // argument: new size
+  reserve   = 3, // argument: capacity
+  clear     = 4,
+  read      = 5  // argument: position, taken modulo the size at replay time
+};
+
+struct trace_record {
+  trace_op op;
+  std::uint64_t arg;
+};
+
+// Shapes of traffic the generator can produce
+enum class trace_workload {
+  queue,      // balanced push_back/pop_back around a steady size, with reads
+  growth,     // mostly push_back with some reads - the vector keeps growing
+  sawtooth,   // grow to a random peak, then shrink by pop_back, resize or clear
+  read_heavy, // mostly random reads over a large vector, hot items first
+  resize      // jumps in size through resize and reserve between pushes
+};
+
+// Writes records in the binary format - throws std::runtime_error on failure
+inline void write_trace(std::ostream& out, const std::vector<trace_record>& records);
+// Reads records in the binary format - throws std::runtime_error if malformed
+inline std::vector<trace_record> read_trace(std::istream& in);
+// Generates ops records following a workload shape, reproducible per seed
+inline std::vector<trace_record> generate_trace(const trace_workload workload,
+                                                const std::size_t ops,
+                                                const unsigned int seed);
+// Returns the workload named name - throws std::invalid_argument if unknown
+inline trace_workload parse_trace_workload(const std::string& name);
+
+/*----------------------------------------*
+ | BEGIN WORKLOAD_TRACE IMPLEMENTATION
+ *----------------------------------------*/
+
+namespace workload_trace_detail {
+
+const char magic[4] = { 'L', 'V', 'T', 'R' };
+const std::uint32_t version = 1;
+
+inline bool has_arg(const trace_op op) {
+  return op == trace_op::resize || op == trace_op::reserve || op == trace_op::read;
+}
+
+inline void write_fixed(std::ostream& out, std::uint64_t val, const int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out.put(static_cast<char>(val & 0xff));
+    val >>= 8;
+  }
+}
+
+inline std::uint64_t read_fixed(std::istream& in, const int bytes) {
+  std::uint64_t val = 0;
+  for (int i = 0; i < bytes; ++i) {
+    const int c = in.get();
+    if (c == std::char_traits<char>::eof())
+      throw std::runtime_error("workload trace truncated");
+    val |= static_cast<std::uint64_t>(c) << (8 * i);
+  }
+  return val;
+}
+
+inline void write_varint(std::ostream& out, std::uint64_t val) {
+  while (val >= 0x80) {
+    out.put(static_cast<char>((val & 0x7f) | 0x80));
+    val >>= 7;
+  }
+  out.put(static_cast<char>(val));
+}
+
+inline std::uint64_t read_varint(std::istream& in) {
+  std::uint64_t val = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    const int c = in.get();
+    if (c == std::char_traits<char>::eof())
+      throw std::runtime_error("workload trace truncated");
+    val |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) return val;
+  }
+  throw std::runtime_error("workload trace has an overlong varint");
+}
+
+// Tracks the size a trace implies so generated pops never underflow
+struct trace_builder {
+  std::vector<trace_record> records;
+  std::uint64_t size;
+
+  trace_builder() : size(0) {}
+
+  void add(const trace_op op, const std::uint64_t arg = 0) {
+    switch (op) {
+      case trace_op::push_back: ++size; break;
+      case trace_op::pop_back:  if (size == 0) return; --size; break;
+      case trace_op::resize:    size = arg; break;
+      case trace_op::clear:     size = 0; break;
+      default: break;
+    }
+    trace_record record = { op, arg };
+    records.push_back(record);
+  }
+};
+
+} // namespace workload_trace_detail
+
+inline void write_trace(std::ostream& out, const std::vector<trace_record>& records) {
+  using namespace workload_trace_detail;
+
+  out.write(magic, sizeof(magic));
+  write_fixed(out, version, 4);
+  write_fixed(out, records.size(), 8);
+  for (const auto& record : records) {
+    out.put(static_cast<char>(record.op));
+    if (has_arg(record.op)) write_varint(out, record.arg);
+  }
+  if (!out) throw std::runtime_error("failed to write workload trace");
+}
+
+inline std::vector<trace_record> read_trace(std::istream& in) {
+  using namespace workload_trace_detail;
+
+  char header[sizeof(magic)];
+  if (!in.read(header, sizeof(header)) || std::string(header, sizeof(header)) !=
+                                          std::string(magic, sizeof(magic)))
+    throw std::runtime_error("not a workload trace");
+  if (read_fixed(in, 4) != version)
+    throw std::runtime_error("unsupported workload trace version");
+
+  const std::uint64_t count = read_fixed(in, 8);
+  std::vector<trace_record> records;
+  // the count is not trusted for more than a modest reservation - a
+  // corrupt header then shows up as a truncated trace
+  records.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(count, 1 << 20)));
+  for (std::uint64_t i = 0; i < count; ++i) {
+    const int c = in.get();
+    if (c == std::char_traits<char>::eof())
+      throw std::runtime_error("workload trace truncated");
+    if (c > static_cast<int>(trace_op::read))
+      throw std::runtime_error("workload trace has an unknown operation");
+
+    trace_record record = { static_cast<trace_op>(c), 0 };
+    if (has_arg(record.op)) record.arg = read_varint(in);
+    records.push_back(record);
+  }
+  return records;
+}
+
+inline std::vector<trace_record> generate_trace(const trace_workload workload,
+                                                const std::size_t ops,
+                                                const unsigned int seed) {
+  using namespace workload_trace_detail;
+
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  trace_builder trace;
+  // random position, read modulo the size at replay time
+  auto any_pos = [&rng]() { return static_cast<std::uint64_t>(rng() >> 1); };
+
+  switch (workload) {
+    case trace_workload::queue: {
+      const std::uint64_t target = 1 << 16;
+      while (trace.records.size() < ops) {
+        const double p = coin(rng);
+        // drift back towards the target size
+        const double push_bias = trace.size < target ? 0.55 : 0.45;
+        if (p < 0.6 * push_bias) trace.add(trace_op::push_back);
+        else if (p < 0.6) trace.add(trace_op::pop_back);
+        else trace.add(trace_op::read, any_pos());
+      }
+      break;
+    }
+    case trace_workload::growth: {
+      while (trace.records.size() < ops) {
+        if (coin(rng) < 0.9) trace.add(trace_op::push_back);
+        else trace.add(trace_op::read, any_pos());
+      }
+      break;
+    }
+    case trace_workload::sawtooth: {
+      std::uniform_int_distribution<std::uint64_t> peak_dist(1 << 10, 1 << 20);
+      while (trace.records.size() < ops) {
+        const std::uint64_t peak = peak_dist(rng);
+        while (trace.size < peak && trace.records.size() < ops) {
+          trace.add(trace_op::push_back);
+        }
+        // shrink in one of the ways production code does
+        const double p = coin(rng);
+        if (p < 0.2) {
+          trace.add(trace_op::clear);
+        }
+        else if (p < 0.4) {
+          trace.add(trace_op::resize, trace.size / 4);
+        }
+        else {
+          const std::uint64_t trough = trace.size / 8;
+          while (trace.size > trough && trace.records.size() < ops) {
+            trace.add(trace_op::pop_back);
+          }
+        }
+      }
+      break;
+    }
+    case trace_workload::read_heavy: {
+      const std::uint64_t fill = ops / 10;
+      for (std::uint64_t i = 0; i < fill; ++i) {
+        trace.add(trace_op::push_back);
+      }
+      // a cube of a uniform sample skews reads towards the front, so a small
+      // set of hot positions takes most of the traffic
+      while (trace.records.size() < ops) {
+        const double p = coin(rng);
+        if (p < 0.05) {
+          trace.add(trace_op::push_back);
+        }
+        else if (p < 0.1) {
+          trace.add(trace_op::pop_back);
+        }
+        else {
+          const double u = coin(rng);
+          trace.add(trace_op::read, static_cast<std::uint64_t>(u * u * u * trace.size));
+        }
+      }
+      break;
+    }
+    case trace_workload::resize: {
+      std::uniform_int_distribution<std::uint64_t> size_dist(0, 1 << 18);
+      while (trace.records.size() < ops) {
+        const double p = coin(rng);
+        if (p < 0.01) trace.add(trace_op::resize, size_dist(rng));
+        else if (p < 0.02) trace.add(trace_op::reserve, trace.size + size_dist(rng));
+        else if (p < 0.6) trace.add(trace_op::push_back);
+        else if (p < 0.8) trace.add(trace_op::pop_back);
+        else trace.add(trace_op::read, any_pos());
+      }
+      break;
+    }
+  }
+  trace.records.resize(ops < trace.records.size() ? ops : trace.records.size());
+  return trace.records;
+}
+
+inline trace_workload parse_trace_workload(const std::string& name) {
+  if (name == "queue") return trace_workload::queue;
+  if (name == "growth") return trace_workload::growth;
+  if (name == "sawtooth") return trace_workload::sawtooth;
+  if (name == "read_heavy") return trace_workload::read_heavy;
+  if (name == "resize") return trace_workload::resize;
+  throw std::invalid_argument("unknown workload '" + name + "'");
+}
+
+/*-----------------------------------------
+ | END WORKLOAD_TRACE IMPLEMENTATION
+ *----------------------------------------*/
+
+#endif // WORKLOAD_TRACE_H_